@@ -1,7 +1,8 @@
 #pragma once
 
 #include "scenario.h"
-#include "MiLi\mili.h"
+#include "MiLi/mili/coroutines.h"
+#include "mili_goto.h"
 #include "mili_helpers.h"
 #include <iostream>
 
@@ -37,6 +38,35 @@ struct MiliTask : Task, mili::Coroutine {
   }
 };
 
+// MiliTask resuming through a label address, see mili_goto.h
+struct MiliTaskGoto : Task, GotoCoroutine {
+
+  int run() {
+    BEGIN_GOTO_COROUTINE
+    while (true) {
+      while (!worker.atMine()) {
+        worker.moveMine();
+        goto_yield(0);
+      }
+      do {
+        worker.gather();
+        goto_yield(0);
+      } while (worker.isMining());
+      while (!worker.atHome()) {
+        worker.moveHome();
+        goto_yield(0);
+      }
+      worker.dropoff();
+      goto_yield(0);
+    }
+    END_GOTO_COROUTINE(0);
+  }
+
+  void print(ostream& stream) const {
+    stream << "Mili goto Coroutine1: " << worker.total << endl;
+  }
+};
+
 
 
 
@@ -1,23 +1,24 @@
 #pragma once
 #include "scenario.h"
-#include "MiLi\mili.h"
+#include "MiLi/mili/coroutines.h"
 #include "mili_helpers.h"
+#include "ring_queue.h"
 #include <iostream>
-#include <queue>
 
 using namespace mili;
 using namespace std;
 
 struct MiliTask2;
 
-static MiliTask2* next_frame2;
-static MiliTask2* end_coro2;
+inline MiliTask2* next_frame2;
+inline MiliTask2* end_coro2;
 
 struct MiliTask2 : mili::Coroutine {
   MiliTask2* caller = nullptr;
   virtual MiliTask2* run() {
     return end_coro2;
   }
+  virtual ~MiliTask2() = default;
 };
 
 struct MiliTask2_Worker : MiliTask2 {
@@ -51,7 +52,8 @@ struct MiliTask2Main : MiliTask2_Worker {
 };
 
 struct MiliTask2Mgr : Task {
-  queue<MiliTask2*> q;
+  // only ever holds its one task
+  RingQueue<MiliTask2*> q{1};
   int run() {
     do {
       auto curr = q.front();
@@ -74,6 +76,13 @@ struct MiliTask2Mgr : Task {
   void print(ostream& stream) const {
     stream << "Mili Coroutine2: " << worker.total << endl;
   }
+
+  ~MiliTask2Mgr() {
+    while (!q.empty()) {
+      delete q.front();
+      q.pop();
+    }
+  }
 };
 
 
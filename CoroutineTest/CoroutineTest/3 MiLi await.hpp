@@ -1,10 +1,12 @@
 #pragma once
 
 #include "scenario.h"
-#include "MiLi\mili\coroutines.h"
+#include "MiLi/mili/coroutines.h"
+#include "cts_trace.h"
+#include "mili_goto.h"
 #include "mili_helpers.h"
+#include "ring_queue.h"
 #include <iostream>
-#include <queue>
 #include <vector>
 
 using namespace mili;
@@ -12,14 +14,45 @@ using namespace std;
 
 struct MiliTask3;
 
-static MiliTask3* next_frame3;
-static MiliTask3* end_coro3;
+// what a task is doing, for MiliTask3PhaseMgr's buckets
+enum MiliTask3Phase {
+  phase_main,
+  phase_goto_mine,
+  phase_gather,
+  phase_dropoff,
+  num_phases3
+};
+
+inline MiliTask3* next_frame3;
+inline MiliTask3* end_coro3;
+
+// mili_yield resuming at a fixed point, numbered 1, 2, ... within each
+// run(), instead of at __LINE__: a snapshot's yield points then survive
+// rebuilds and edits that leave the coroutines' shape alone
+#define mili3_yield(point, value) \
+  do                              \
+  {                               \
+    yield_point = (point);        \
+    return (value);               \
+    case (point):;                \
+  }                               \
+  while(0)
 
 struct MiliTask3 : mili::Coroutine {
   MiliTask3* caller = nullptr;
+  int phase = phase_main;
   virtual MiliTask3* run() {
     return end_coro3;
   }
+  // labels this task's spans in traces
+  virtual char const* name() const {
+    return "MiliTask3";
+  }
+  // where run() continues, for snapshots: 0 or one of its mili3_yield
+  // points, of which a class has resume_points
+  static constexpr int resume_points = 0;
+  int resumePoint() const { return yield_point; }
+  void setResumePoint(int point) { yield_point = point; }
   virtual ~MiliTask3() = default;
 };
 
@@ -33,14 +66,19 @@ struct MiliTask3_GotoMine : MiliTask3_Worker {
     BEGIN_COROUTINE
       while (!worker.atMine()) {
         worker.moveMine();
-        mili_yield(next_frame3);
+        mili3_yield(1, next_frame3);
       }
     END_COROUTINE(end_coro3);
   }
+  static constexpr int resume_points = 1;
+  char const* name() const override {
+    return "GotoMine";
+  }
   MiliTask3_GotoMine(Worker& p_worker, MiliTask3* p_caller)
     :MiliTask3_Worker(p_worker)
   {
     caller = p_caller;
+    phase = phase_goto_mine;
   }
 };
 
@@ -49,14 +87,19 @@ struct MiliTask3_Gather : MiliTask3_Worker {
     BEGIN_COROUTINE
       do {
         worker.gather();
-        mili_yield(next_frame3);
+        mili3_yield(1, next_frame3);
       } while (worker.isMining());
     END_COROUTINE(end_coro3);
   }
+  static constexpr int resume_points = 1;
+  char const* name() const override {
+    return "Gather";
+  }
   MiliTask3_Gather(Worker& p_worker, MiliTask3* p_caller)
     :MiliTask3_Worker(p_worker)
   {
     caller = p_caller;
+    phase = phase_gather;
   }
 };
 
@@ -65,80 +108,307 @@ struct MiliTask3_Dropoff : MiliTask3_Worker {
     BEGIN_COROUTINE
       while (!worker.atHome()) {
         worker.moveHome();
-        mili_yield(next_frame3);
+        mili3_yield(1, next_frame3);
       }
       worker.dropoff();
       END_COROUTINE(end_coro3);
   }
+  static constexpr int resume_points = 1;
+  char const* name() const override {
+    return "Dropoff";
+  }
   MiliTask3_Dropoff(Worker& p_worker, MiliTask3* p_caller)
     :MiliTask3_Worker(p_worker)
   {
     caller = p_caller;
+    phase = phase_dropoff;
   }
 };
 
 struct MiliTask3Main : MiliTask3_Worker {
   Worker m_worker;
+  // position in MiliTask3Mgr::tasks
+  int index = 0;
   MiliTask3Main(): MiliTask3_Worker(m_worker) {}
+  char const* name() const override {
+    return "Main";
+  }
 
   MiliTask3* run() override {
     BEGIN_COROUTINE
       while (true) {
-        mili_yield(new MiliTask3_GotoMine(worker, this));
-        mili_yield(new MiliTask3_Gather(worker, this));
-        mili_yield(new MiliTask3_Dropoff(worker, this));
+        mili3_yield(1, new MiliTask3_GotoMine(worker, this));
+        mili3_yield(2, new MiliTask3_Gather(worker, this));
+        mili3_yield(3, new MiliTask3_Dropoff(worker, this));
       }
     END_COROUTINE(end_coro3);
   }
+  static constexpr int resume_points = 3;
 };
 
-struct MiliTask3Mgr : Task{
-  queue<MiliTask3*> q;
-  std::vector<MiliTask3Main*> tasks;
+// MiliTask3's tasks resuming through a label address, see mili_goto.h;
+// they only replace run(), the MiliTask3 yield_point goes unused
+struct MiliTask3Goto_GotoMine : MiliTask3_GotoMine, GotoCoroutine {
+  using MiliTask3_GotoMine::MiliTask3_GotoMine;
+  MiliTask3* run() override {
+    BEGIN_GOTO_COROUTINE
+      while (!worker.atMine()) {
+        worker.moveMine();
+        goto_yield(next_frame3);
+      }
+    END_GOTO_COROUTINE(end_coro3);
+  }
+};
+
+struct MiliTask3Goto_Gather : MiliTask3_Gather, GotoCoroutine {
+  using MiliTask3_Gather::MiliTask3_Gather;
+  MiliTask3* run() override {
+    BEGIN_GOTO_COROUTINE
+      do {
+        worker.gather();
+        goto_yield(next_frame3);
+      } while (worker.isMining());
+    END_GOTO_COROUTINE(end_coro3);
+  }
+};
+
+struct MiliTask3Goto_Dropoff : MiliTask3_Dropoff, GotoCoroutine {
+  using MiliTask3_Dropoff::MiliTask3_Dropoff;
+  MiliTask3* run() override {
+    BEGIN_GOTO_COROUTINE
+      while (!worker.atHome()) {
+        worker.moveHome();
+        goto_yield(next_frame3);
+      }
+      worker.dropoff();
+    END_GOTO_COROUTINE(end_coro3);
+  }
+};
+
+struct MiliTask3Goto_Main : MiliTask3Main, GotoCoroutine {
+  MiliTask3* run() override {
+    BEGIN_GOTO_COROUTINE
+      while (true) {
+        goto_yield(new MiliTask3Goto_GotoMine(worker, this));
+        goto_yield(new MiliTask3Goto_Gather(worker, this));
+        goto_yield(new MiliTask3Goto_Dropoff(worker, this));
+      }
+    END_GOTO_COROUTINE(end_coro3);
+  }
+};
+
+// cts::Tracer hooks for the managers: task is about to run, or ran and
+// returned awt. Compiled out unless CTS_TRACE is defined.
+inline void traceResume(MiliTask3* task) {
+  cts::Tracer::record(cts::TraceEvent::resume, task, task->caller);
+}
+
+inline void traceCreate(MiliTask3* task) {
+  if constexpr (cts::Tracer::enabled) {
+    cts::Tracer::record(cts::TraceEvent::create, task);
+    cts::Tracer::record(cts::TraceEvent::name, task, task->name());
+  }
+}
+
+inline void traceReturn(MiliTask3* task, MiliTask3* awt) {
+  if constexpr (cts::Tracer::enabled) {
+    if (awt == next_frame3) {
+      cts::Tracer::record(cts::TraceEvent::suspend, task);
+    } else if (awt == end_coro3) {
+      cts::Tracer::record(cts::TraceEvent::complete, task, task->caller);
+    } else {
+      // awaits a new subtask
+      cts::Tracer::record(cts::TraceEvent::suspend, task, awt);
+      traceCreate(awt);
+    }
+  }
+}
+
+// Main: MiliTask3Main or a class derived from it
+template<typename Main>
+struct BasicMiliTask3Mgr : Task{
+  // one entry per main task, grown by addTask
+  RingQueue<MiliTask3*> q;
+  std::vector<Main*> tasks;
+  // the original scheduler: run the queue until one task yields
+  // next_frame3
   int run() override {
-    do {
+    while (!q.empty()) {
       auto curr = q.front();
       q.pop();
+      traceResume(curr);
       auto awt = curr->run();
+      traceReturn(curr, awt);
       if (awt == next_frame3) {
         q.push(curr);
         break;
       }
       if (awt == end_coro3 && curr->caller != nullptr) {
         q.push(curr->caller);
+        delete curr;
         continue;
       }
       if (awt->caller != nullptr) {
         q.push(awt);
         continue;
       }
-    } while (!q.empty());
+    }
     return 0;
   }
 
+  // every task steps until it waits for the next frame
+  void runFrame() {
+    // one queue entry per task; a task's awaits and returns are followed
+    // right away so nothing already done this frame runs again
+    for (auto n = q.size(); n > 0; --n) {
+      auto curr = q.front();
+      q.pop();
+      while (curr != nullptr) {
+        traceResume(curr);
+        auto awt = curr->run();
+        traceReturn(curr, awt);
+        if (awt == next_frame3) {
+          q.push(curr);
+          break;
+        }
+        auto const finished = curr;
+        curr = nullptr;
+        if (awt == end_coro3 && finished->caller != nullptr) {
+          curr = finished->caller;
+          delete finished;
+        } else if (awt->caller != nullptr) {
+          curr = awt;
+        }
+      }
+    }
+  }
+
+  int total() const override {
+    auto count = 0;
+    for(auto t : tasks) {
+      count += t->m_worker.total;
+    }
+    return count;
+  }
+
   void addTask()
   {
-    auto const t = new MiliTask3Main();
+    auto const t = new Main();
+    t->index = static_cast<int>(tasks.size());
+    traceCreate(t);
     tasks.push_back(t);
     q.push(t);
   }
 
   void print(ostream& stream) const override {
+    stream << " Mili Coroutine3: " << total() << endl;
+  }
+
+  // delete every task, leaving an empty manager to refill
+  void clear() {
+    // queued subtasks belong to a main task, which is only in tasks
+    while(!q.empty()) {
+      auto const t = q.front();
+      if (t->caller != nullptr) delete t;
+      q.pop();
+    }
+    for(auto t : tasks) {
+      delete t;
+    }
+    tasks.clear();
+  }
+
+  ~BasicMiliTask3Mgr() override {
+    clear();
+  }
+};
+
+using MiliTask3Mgr = BasicMiliTask3Mgr<MiliTask3Main>;
+
+/**
+ * Same tasks as MiliTask3Mgr, but queued by the phase they resume in: a
+ * frame runs every GotoMine continuation, then every Gather, and so on,
+ * instead of jumping between code paths worker by worker. Awaits and
+ * returns are still followed right away, while the worker is in cache;
+ * they happen a few times a trip, the resumes every frame.
+ */
+struct MiliTask3PhaseMgr : Task {
+  // yielded next_frame3, by the phase they resume in
+  std::vector<MiliTask3*> waiting[num_phases3];
+  // this frame's buckets, swapped with waiting at the start of a frame
+  std::vector<MiliTask3*> runnable[num_phases3];
+  std::vector<MiliTask3Main*> tasks;
+
+  int run() override {
+    runFrame();
+    return 0;
+  }
+
+  void runFrame() {
+    for (auto p = 0; p < num_phases3; ++p) {
+      runnable[p].swap(waiting[p]);
+    }
+    for (auto & bucket : runnable) {
+      for (auto curr : bucket) {
+        step(curr);
+      }
+      bucket.clear();
+    }
+  }
+
+  void addTask()
+  {
+    auto const t = new MiliTask3Main();
+    traceCreate(t);
+    tasks.push_back(t);
+    waiting[t->phase].push_back(t);
+  }
+
+  int total() const override {
     auto count = 0;
     for(auto t : tasks) {
       count += t->m_worker.total;
     }
-    stream << " Mili Coroutine3: " << count << endl;
+    return count;
   }
 
-  ~MiliTask3Mgr() override {
-    while(!q.empty()) {
-      auto const t = q.front();
+  void print(ostream& stream) const override {
+    stream << " Mili Coroutine3 by phase: " << total() << endl;
+  }
+
+  ~MiliTask3PhaseMgr() override {
+    for (auto const& bucket : waiting) {
+      for (auto t : bucket) {
+        if (t->caller != nullptr) delete t;
+      }
+    }
+    for(auto t : tasks) {
       delete t;
-      q.pop();
     }
     tasks.clear();
   }
+
+private:
+  // run a task until it waits for the next frame
+  void step(MiliTask3* curr) {
+    while (curr != nullptr) {
+      traceResume(curr);
+      auto awt = curr->run();
+      traceReturn(curr, awt);
+      if (awt == next_frame3) {
+        waiting[curr->phase].push_back(curr);
+        return;
+      }
+      auto const finished = curr;
+      curr = nullptr;
+      if (awt == end_coro3 && finished->caller != nullptr) {
+        curr = finished->caller;
+        delete finished;
+      } else if (awt->caller != nullptr) {
+        curr = awt;
+      }
+    }
+  }
 };
 
 
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "scenario.h"
+#include "MiLi/mili/coroutines.h"
+#include "cts_trace.h"
+#include "mili_helpers.h"
+#include <iostream>
+#include <variant>
+#include <vector>
+
+using namespace mili;
+using namespace std;
+
+// what a MiliTask4 coroutine returns to whoever resumed it
+enum class MiliResume4 : uint8_t {
+  next_frame,
+  done
+};
+
+/**
+ * Awaits a child coroutine kept inline in the caller: the child is built
+ * in place in `slot`, a std::variant of the children the caller can await,
+ * and run(args...) from there until it returns done. Each resume that reaches
+ * this line runs the child again, so a child yielding next_frame suspends
+ * the caller too; when it finishes the caller carries on in the same
+ * frame, as with MiliTask3's subtasks. Awaiting allocates nothing, and the
+ * next await reuses the slot.
+ */
+#define mili_await(slot, Child, ...)                                        \
+  do                                                                        \
+  {                                                                         \
+    (slot).template emplace<Child>();                                       \
+    yield_point = __LINE__;                                                 \
+    [[fallthrough]];                                                        \
+    case __LINE__:                                                          \
+    if (std::get<Child>(slot).run(__VA_ARGS__) == MiliResume4::next_frame)  \
+      return MiliResume4::next_frame;                                       \
+  }                                                                         \
+  while(0)
+
+struct MiliTask4_GotoMine : mili::Coroutine {
+  MiliResume4 run(Worker& worker) {
+    BEGIN_COROUTINE
+      while (!worker.atMine()) {
+        worker.moveMine();
+        mili_yield(MiliResume4::next_frame);
+      }
+    END_COROUTINE(MiliResume4::done);
+  }
+};
+
+struct MiliTask4_Gather : mili::Coroutine {
+  MiliResume4 run(Worker& worker) {
+    BEGIN_COROUTINE
+      do {
+        worker.gather();
+        mili_yield(MiliResume4::next_frame);
+      } while (worker.isMining());
+    END_COROUTINE(MiliResume4::done);
+  }
+};
+
+struct MiliTask4_Dropoff : mili::Coroutine {
+  MiliResume4 run(Worker& worker) {
+    BEGIN_COROUTINE
+      while (!worker.atHome()) {
+        worker.moveHome();
+        mili_yield(MiliResume4::next_frame);
+      }
+      worker.dropoff();
+    END_COROUTINE(MiliResume4::done);
+  }
+};
+
+/**
+ * MiliTask3Main with its subtasks inline: the Worker and whichever child
+ * it is awaiting live in one object, so a manager can keep every task in
+ * one vector and a trip costs no allocations at all. The children are
+ * handed the Worker on each resume rather than keeping a reference, so a
+ * task stays a plain value that can be copied or moved mid-run.
+ */
+struct MiliTask4 : mili::Coroutine {
+  Worker m_worker;
+  std::variant<std::monostate, MiliTask4_GotoMine, MiliTask4_Gather,
+               MiliTask4_Dropoff> m_child;
+
+  MiliResume4 run() {
+    BEGIN_COROUTINE
+      while (true) {
+        mili_await(m_child, MiliTask4_GotoMine, m_worker);
+        mili_await(m_child, MiliTask4_Gather, m_worker);
+        mili_await(m_child, MiliTask4_Dropoff, m_worker);
+      }
+    END_COROUTINE(MiliResume4::done);
+  }
+};
+
+struct MiliTask4Mgr : Task {
+  // never suspended for longer than a frame, so no queue is needed
+  std::vector<MiliTask4> tasks;
+
+  int run() override {
+    runFrame();
+    return 0;
+  }
+
+  void runFrame() {
+    for (auto & t : tasks) {
+      cts::Tracer::record(cts::TraceEvent::resume, &t);
+      t.run();
+      cts::Tracer::record(cts::TraceEvent::suspend, &t);
+    }
+  }
+
+  MiliTask4& addTask() {
+    tasks.emplace_back();
+    return tasks.back();
+  }
+
+  int total() const override {
+    auto count = 0;
+    for (auto const& t : tasks) {
+      count += t.m_worker.total;
+    }
+    return count;
+  }
+
+  void print(ostream& stream) const override {
+    stream << " Mili Coroutine4: " << total() << endl;
+  }
+};
+
+
+inline int runMili4() {
+  cout << "MiLi coroutines with inline await" << endl;
+  auto *task = new MiliTask4Mgr();
+  task->tasks.reserve(num_tasks);
+  for(int i=0; i < num_tasks; ++i) {
+    task->addTask();
+  }
+  World world(task);
+  return world.run();
+}
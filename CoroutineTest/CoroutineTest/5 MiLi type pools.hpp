@@ -0,0 +1,135 @@
+#pragma once
+
+#include "3 MiLi await.hpp"
+#include "4 MiLi inline await.hpp"
+#include <cstdint>
+#include <vector>
+
+/**
+ * MiliTask3Main's loop with the subtask to await returned as a phase
+ * rather than a new object: MiliTask3PoolMgr starts the subtask itself,
+ * in the pool for its type.
+ */
+struct MiliTask3Pooled : mili::Coroutine {
+  Worker m_worker;
+  MiliTask3Phase run() {
+    BEGIN_COROUTINE
+      while (true) {
+        mili_yield(phase_goto_mine);
+        mili_yield(phase_gather);
+        mili_yield(phase_dropoff);
+      }
+    END_COROUTINE(phase_main);
+  }
+};
+
+/**
+ * MiliTask3's scenario over a closed set of task types: every subtask of
+ * one type waits in that type's pool, kept as values next to the index of
+ * the main task awaiting it. A frame runs each pool in one loop calling a
+ * known run(), so there are no virtual calls, no allocations once the
+ * pools have grown, and the Workers are reached by index instead of a
+ * caller chain. As in MiliTask3Mgr, a subtask that finishes resumes its
+ * main task straight away, which starts the next subtask in the same
+ * frame; arrivals in a pool wait for the next frame.
+ */
+struct MiliTask3PoolMgr : Task {
+  template<typename Child>
+  struct Pool {
+    std::vector<Child> m_children;
+    // which entry of tasks each child works for
+    std::vector<uint32_t> m_mains;
+    // entries waiting since before this frame
+    size_t m_waiting = 0;
+  };
+
+  std::vector<MiliTask3Pooled> tasks;
+  Pool<MiliTask4_GotoMine> m_goto_mine;
+  Pool<MiliTask4_Gather> m_gather;
+  Pool<MiliTask4_Dropoff> m_dropoff;
+  // added since the last frame, not run yet
+  std::vector<uint32_t> m_starting;
+
+  int run() override {
+    runFrame();
+    return 0;
+  }
+
+  void runFrame() {
+    m_goto_mine.m_waiting = m_goto_mine.m_children.size();
+    m_gather.m_waiting = m_gather.m_children.size();
+    m_dropoff.m_waiting = m_dropoff.m_children.size();
+    for (auto main : m_starting) {
+      resume(main);
+    }
+    m_starting.clear();
+    runPool(m_goto_mine);
+    runPool(m_gather);
+    runPool(m_dropoff);
+  }
+
+  MiliTask3Pooled& addTask() {
+    m_starting.push_back(static_cast<uint32_t>(tasks.size()));
+    tasks.emplace_back();
+    return tasks.back();
+  }
+
+  int total() const override {
+    auto count = 0;
+    for (auto const& t : tasks) {
+      count += t.m_worker.total;
+    }
+    return count;
+  }
+
+  void print(ostream& stream) const override {
+    stream << " Mili Coroutine3 in type pools: " << total() << endl;
+  }
+
+private:
+  // run main until it awaits a subtask that does not finish at once
+  void resume(uint32_t main) {
+    auto started = false;
+    while (!started) {
+      switch (tasks[main].run()) {
+        case phase_goto_mine: started = start(m_goto_mine, main); break;
+        case phase_gather: started = start(m_gather, main); break;
+        case phase_dropoff: started = start(m_dropoff, main); break;
+        default: return;
+      }
+    }
+  }
+
+  // run a new child once; false if it finished without yielding
+  template<typename Child>
+  bool start(Pool<Child>& pool, uint32_t main) {
+    auto child = Child{};
+    if (child.run(tasks[main].m_worker) == MiliResume4::done) return false;
+    pool.m_children.push_back(child);
+    pool.m_mains.push_back(main);
+    return true;
+  }
+
+  template<typename Child>
+  void runPool(Pool<Child>& pool) {
+    size_t kept = 0;
+    for (size_t i = 0; i < pool.m_waiting; ++i) {
+      auto const main = pool.m_mains[i];
+      if (pool.m_children[i].run(tasks[main].m_worker)
+          == MiliResume4::next_frame) {
+        pool.m_children[kept] = pool.m_children[i];
+        pool.m_mains[kept] = main;
+        ++kept;
+      } else {
+        // may append to any pool, this one included
+        resume(main);
+      }
+    }
+    // close the gap finished children left, keeping the arrivals in order
+    pool.m_children.erase(pool.m_children.begin() + kept,
+                          pool.m_children.begin() + pool.m_waiting);
+    pool.m_mains.erase(pool.m_mains.begin() + kept,
+                       pool.m_mains.begin() + pool.m_waiting);
+    pool.m_waiting = 0;
+  }
+};
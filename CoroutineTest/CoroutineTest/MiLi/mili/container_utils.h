@@ -37,7 +37,7 @@ NAMESPACE_BEGIN
 struct ElementNotFound : std::exception {};
 
 template <class Container, class Element>
-inline Element& find(Container& c, const Element& element) throw(ElementNotFound)
+inline Element& find(Container& c, const Element& element)
 {
     const typename Container::iterator it = find(c.begin(), c.end(), element);
     if (it == c.end())
@@ -47,7 +47,7 @@ inline Element& find(Container& c, const Element& element) throw(ElementNotFound
 }
 
 template <class Container, class Element>
-inline const Element& find(const Container& c, const Element& element) throw(ElementNotFound)
+inline const Element& find(const Container& c, const Element& element)
 {
     const typename Container::const_iterator it = find(c.begin(), c.end(), element);
     if (it == c.end())
@@ -57,7 +57,7 @@ inline const Element& find(const Container& c, const Element& element) throw(Ele
 }
 
 template <class Key, class T, class Comp, class Alloc, class Key2>
-inline T& find(std::map<Key, T, Comp, Alloc>& m, const Key2& key) throw(ElementNotFound)
+inline T& find(std::map<Key, T, Comp, Alloc>& m, const Key2& key)
 {
     const typename std::map<Key, T, Comp, Alloc>::iterator it = m.find(key);
     if (it == m.end())
@@ -67,7 +67,7 @@ inline T& find(std::map<Key, T, Comp, Alloc>& m, const Key2& key) throw(ElementN
 }
 
 template <class Key, class T, class Comp, class Alloc, class Key2>
-inline const T& find(const std::map<Key, T, Comp, Alloc>& m, const Key2& key) throw(ElementNotFound)
+inline const T& find(const std::map<Key, T, Comp, Alloc>& m, const Key2& key)
 {
     const typename std::map<Key, T, Comp, Alloc>::const_iterator it = m.find(key);
     if (it == m.end())
@@ -0,0 +1,208 @@
+#include "alloc_stats.h"
+#include "benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// replaces the global allocation functions so the suite can count them
+namespace {
+// striped so threads allocating in parallel do not share a cache line
+constexpr int num_stripes = 64;
+struct alignas(64) Stripe {
+  std::atomic<int64_t> m_allocations{0};
+  std::atomic<int64_t> m_bytes{0};
+  std::atomic<int64_t> m_coroutine_frames{0};
+  std::atomic<int64_t> m_coroutine_frame_bytes{0};
+};
+Stripe g_stripes[num_stripes];
+std::atomic<int> g_next_stripe{0};
+// live bytes need one counter to have a peak
+std::atomic<int64_t> g_live_bytes{0};
+std::atomic<int64_t> g_peak_live_bytes{0};
+
+// with BENCH_ALLOC_STATS every block starts with its size
+constexpr size_t header_size = alignof(std::max_align_t);
+
+Stripe& localStripe() {
+  thread_local auto & stripe =
+    g_stripes[g_next_stripe.fetch_add(1, std::memory_order_relaxed)
+              % num_stripes];
+  return stripe;
+}
+
+void addLive(int64_t bytes) {
+  auto const live =
+    g_live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  auto peak = g_peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak
+         && !g_peak_live_bytes.compare_exchange_weak(
+              peak, live, std::memory_order_relaxed)) {}
+}
+
+void* counted_new(size_t size) {
+  auto & stripe = localStripe();
+  stripe.m_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  auto const total = alloc_stats_enabled ? size + header_size : size;
+  while (true) {
+    if (auto const block = std::malloc(total)) {
+      if (!alloc_stats_enabled) return block;
+      *static_cast<size_t*>(block) = size;
+      stripe.m_bytes.fetch_add(static_cast<int64_t>(size),
+                               std::memory_order_relaxed);
+      addLive(static_cast<int64_t>(size));
+      return static_cast<char*>(block) + header_size;
+    }
+    auto const handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+// for the align_val_t overloads, which the AlignedAllocator of WorkerPool
+// goes through; the header grows to a multiple of the alignment
+void* counted_new(size_t size, std::align_val_t align) {
+  auto & stripe = localStripe();
+  stripe.m_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  auto const alignment = std::max(static_cast<size_t>(align), header_size);
+  auto const header = alloc_stats_enabled ? alignment : 0;
+  // aligned_alloc wants a multiple of the alignment
+  auto const total = (size + header + alignment - 1) / alignment * alignment;
+  while (true) {
+#if defined(_MSC_VER)
+    auto const block = _aligned_malloc(total, alignment);
+#else
+    auto const block = std::aligned_alloc(alignment, total);
+#endif
+    if (block) {
+      if (!alloc_stats_enabled) return block;
+      *static_cast<size_t*>(block) = size;
+      stripe.m_bytes.fetch_add(static_cast<int64_t>(size),
+                               std::memory_order_relaxed);
+      addLive(static_cast<int64_t>(size));
+      return static_cast<char*>(block) + header;
+    }
+    auto const handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void counted_delete(void* block, std::align_val_t align) noexcept {
+  if (block && alloc_stats_enabled) {
+    block = static_cast<char*>(block)
+          - std::max(static_cast<size_t>(align), header_size);
+    g_live_bytes.fetch_sub(static_cast<int64_t>(*static_cast<size_t*>(block)),
+                           std::memory_order_relaxed);
+  }
+#if defined(_MSC_VER)
+  _aligned_free(block);
+#else
+  std::free(block);
+#endif
+}
+
+void counted_delete(void* block) noexcept {
+  if (!alloc_stats_enabled || !block) {
+    std::free(block);
+    return;
+  }
+  auto const start = static_cast<char*>(block) - header_size;
+  g_live_bytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t*>(start)),
+                         std::memory_order_relaxed);
+  std::free(start);
+}
+}
+
+namespace bench {
+int64_t globalAllocations() {
+  int64_t total = 0;
+  for (auto const& stripe : g_stripes) {
+    total += stripe.m_allocations.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+}
+
+AllocationStats allocationStats() {
+  auto stats = AllocationStats{};
+  for (auto const& stripe : g_stripes) {
+    stats.m_allocations += stripe.m_allocations.load(std::memory_order_relaxed);
+    stats.m_bytes += stripe.m_bytes.load(std::memory_order_relaxed);
+    stats.m_coroutine_frames +=
+      stripe.m_coroutine_frames.load(std::memory_order_relaxed);
+    stats.m_coroutine_frame_bytes +=
+      stripe.m_coroutine_frame_bytes.load(std::memory_order_relaxed);
+  }
+  stats.m_live_bytes = g_live_bytes.load(std::memory_order_relaxed);
+  stats.m_peak_live_bytes = g_peak_live_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void resetPeakLiveBytes() {
+  g_peak_live_bytes.store(g_live_bytes.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+}
+
+int64_t takePeakLiveBytes() {
+  return g_peak_live_bytes.exchange(
+    g_live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void countCoroutineFrame(size_t bytes) {
+  if (!alloc_stats_enabled) return;
+  auto & stripe = localStripe();
+  stripe.m_coroutine_frames.fetch_add(1, std::memory_order_relaxed);
+  stripe.m_coroutine_frame_bytes.fetch_add(static_cast<int64_t>(bytes),
+                                           std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+  return counted_new(size);
+}
+
+void* operator new[](size_t size) {
+  return counted_new(size);
+}
+
+void operator delete(void* block) noexcept {
+  counted_delete(block);
+}
+
+void operator delete[](void* block) noexcept {
+  counted_delete(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+  counted_delete(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+  counted_delete(block);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+  return counted_new(size, align);
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+  return counted_new(size, align);
+}
+
+void operator delete(void* block, std::align_val_t align) noexcept {
+  counted_delete(block, align);
+}
+
+void operator delete[](void* block, std::align_val_t align) noexcept {
+  counted_delete(block, align);
+}
+
+void operator delete(void* block, size_t, std::align_val_t align) noexcept {
+  counted_delete(block, align);
+}
+
+void operator delete[](void* block, size_t, std::align_val_t align) noexcept {
+  counted_delete(block, align);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#if defined(BENCH_ALLOC_STATS)
+constexpr bool alloc_stats_enabled = true;
+#else
+constexpr bool alloc_stats_enabled = false;
+#endif
+
+/**
+ * Heap use seen by alloc_counter.cpp's global operator new and delete,
+ * the aligned forms included, since the start of the program. Allocations
+ * are always counted; bytes, live bytes and coroutine frames cost a size
+ * header and a shared atomic per allocation, so they are only kept in a
+ * BENCH_ALLOC_STATS build and read zero otherwise.
+ */
+struct AllocationStats {
+  int64_t m_allocations = 0;
+  int64_t m_bytes = 0;
+  int64_t m_live_bytes = 0;
+  // highest m_live_bytes since the last resetPeakLiveBytes
+  int64_t m_peak_live_bytes = 0;
+  // coroutine frames created, from the heap, a FrameArena or a FrameCache
+  int64_t m_coroutine_frames = 0;
+  int64_t m_coroutine_frame_bytes = 0;
+};
+
+AllocationStats allocationStats();
+// start tracking the peak again from what is live now
+void resetPeakLiveBytes();
+// the peak since the last reset, then resetPeakLiveBytes; called at frame
+// boundaries for the highest live bytes within one frame
+int64_t takePeakLiveBytes();
+// called by cts::allocateFrame, which hands out frames without new
+void countCoroutineFrame(size_t bytes);
@@ -0,0 +1,492 @@
+#include "benchmark.h"
+#include "alloc_stats.h"
+#include "1 MiLi coroutine.h"
+#include "2 MiLi queue.h"
+#include "3 MiLi await.hpp"
+#include "4 MiLi inline await.hpp"
+#include "5 MiLi type pools.hpp"
+#include "cts_chrome_trace.h"
+#include "cts_generator.h"
+#include "cts_tasks.h"
+#include "cts_value_task.h"
+#include "mili_locals.h"
+#include "mili_snapshot.h"
+#include "parallel_world.h"
+#include "perf_counters.h"
+#include "ring_queue.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+
+namespace bench {
+
+namespace {
+// set by run_suite while --trace is writing
+cts::ChromeTraceWriter* active_trace = nullptr;
+
+// frames for one round trip of the scenario Worker, dropoff included
+constexpr int trip_frames =
+  2 * distance_to_mine / worker_speed + mining_frames + 1;
+
+bool selected(Config const& config, std::string const& name) {
+  return config.m_only.empty() || config.m_only == name;
+}
+
+int startPosition(Config const& config, int index) {
+  return config.m_stagger ? index % distance_to_mine : 0;
+}
+
+// a Worker that starts p steps out is p steps into its first trip
+int64_t expectedTotal(Config const& config, int steps, int frames_per_trip) {
+  if (steps <= 0) return 0;
+  int64_t trips = 0;
+  for (auto i = 0; i < config.m_tasks; ++i) {
+    trips += (steps + startPosition(config, i)) / frames_per_trip;
+  }
+  return trips * worker_capacity;
+}
+
+// plain MiLi coroutines, one per Worker
+template<typename Coroutine = MiliTask>
+struct MiliPool : Task {
+  std::vector<Coroutine> m_tasks;
+  explicit MiliPool(Config const& config) : m_tasks(config.m_tasks) {
+    for (auto i = 0; i < config.m_tasks; ++i) {
+      m_tasks[i].worker.position = startPosition(config, i);
+    }
+  }
+  int run() override {
+    for (auto & t : m_tasks) {
+      t.run();
+    }
+    return 0;
+  }
+  int total() const override {
+    auto count = 0;
+    for (auto const& t : m_tasks) {
+      count += t.worker.total;
+    }
+    return count;
+  }
+};
+
+// one managed queue per Worker
+struct Mili2Pool : Task {
+  std::vector<std::unique_ptr<MiliTask2Mgr>> m_managers;
+  explicit Mili2Pool(Config const& config) {
+    static MiliTask2 next_frame;
+    static MiliTask2 end_coro;
+    next_frame2 = &next_frame;
+    end_coro2 = &end_coro;
+    for (auto i = 0; i < config.m_tasks; ++i) {
+      m_managers.push_back(std::make_unique<MiliTask2Mgr>());
+      m_managers.back()->worker.position = startPosition(config, i);
+    }
+  }
+  int run() override {
+    for (auto & m : m_managers) {
+      m->run();
+    }
+    return 0;
+  }
+  int total() const override {
+    auto count = 0;
+    for (auto const& m : m_managers) {
+      count += m->total();
+    }
+    return count;
+  }
+};
+
+// awaiting subtasks, all Workers in one queue or bucketed by phase
+template<typename Manager>
+struct Mili3Frame : Task {
+  MiliTask3 m_next_frame;
+  MiliTask3 m_end_coro;
+  Manager m_manager;
+  explicit Mili3Frame(Config const& config) {
+    next_frame3 = &m_next_frame;
+    end_coro3 = &m_end_coro;
+    for (auto i = 0; i < config.m_tasks; ++i) {
+      m_manager.addTask();
+      m_manager.tasks.back()->m_worker.position = startPosition(config, i);
+    }
+  }
+  int run() override {
+    m_manager.runFrame();
+    return 0;
+  }
+  int total() const override {
+    return m_manager.total();
+  }
+};
+
+// MiliTask3's scenario with every main task by value in one vector:
+// MiliTask4Mgr or MiliTask3PoolMgr
+template<typename Manager = MiliTask4Mgr>
+struct Mili4World : Task {
+  Manager m_manager;
+  explicit Mili4World(Config const& config) {
+    m_manager.tasks.reserve(config.m_tasks);
+    for (auto i = 0; i < config.m_tasks; ++i) {
+      m_manager.addTask().m_worker.position = startPosition(config, i);
+    }
+  }
+  int run() override {
+    m_manager.runFrame();
+    return 0;
+  }
+  int total() const override {
+    return m_manager.total();
+  }
+};
+
+// Coroutines TS tasks sleeping on the timing wheel
+template<typename Miner = cts::MinerTask>
+struct CtsWorld : Task {
+  std::vector<std::unique_ptr<Miner>> m_miners;
+  cts::TaskManager m_manager;
+  CtsWorld(Config const& config, bool group_by_phase)
+  : m_manager(config.m_threads) {
+    m_manager.m_group_by_phase = group_by_phase;
+    for (auto i = 0; i < config.m_tasks; ++i) {
+      m_miners.push_back(std::make_unique<Miner>(&m_manager));
+      auto & miner = *m_miners.back();
+      miner.m_worker.position = startPosition(config, i);
+      m_manager.spawn([&] { return miner.run(); });
+    }
+  }
+  int run() override {
+    m_manager.nextFrame();
+    return 0;
+  }
+  int total() const override {
+    auto count = 0;
+    for (auto const& m : m_miners) {
+      count += m->m_worker.total;
+    }
+    return count;
+  }
+  int idleFrames() const override {
+    auto const next = m_manager.nextEventFrame();
+    if (next == cts::TimingWheel::never) return std::numeric_limits<int>::max();
+    auto const idle = next - m_manager.frame() - 1;
+    return static_cast<int>(std::min<int64_t>(idle, std::numeric_limits<int>::max()));
+  }
+  void skipFrames(int frames) override {
+    m_manager.skipFrames(frames);
+  }
+};
+
+// no coroutines: every field of every Worker in one pass of vector code
+struct PoolWorld : Task {
+  WorkerPool m_pool;
+  explicit PoolWorld(Config const& config) : m_pool(config.m_tasks) {
+    for (auto i = 0; i < config.m_tasks; ++i) {
+      m_pool.m_position[i] = startPosition(config, i);
+    }
+  }
+  int run() override {
+    m_pool.nextFrame();
+    return 0;
+  }
+  int total() const override {
+    return static_cast<int>(m_pool.total());
+  }
+};
+
+// WorldType: World or ParallelWorld
+template<typename WorldType>
+Result measureWorld(char const* name, Config const& config, WorldType& world,
+               int64_t expected, int num_threads = 1) {
+  world.frame_ns.reserve(config.m_frames);
+  PerfCounters counters;
+  // setup is traced too, it names the coroutines
+  if (active_trace) active_trace->beginProcess(name);
+  auto const allocations = globalAllocations();
+  auto const heap = allocationStats();
+  counters.start();
+  if (active_trace) {
+    // drain the rings every frame, they only hold about one
+    auto & trace = *active_trace;
+    world.runTimed(config.m_frames, [&trace] { trace.flush(); });
+  } else {
+    world.runTimed(config.m_frames);
+  }
+  auto const counts = counters.stop();
+  auto const heap_after = allocationStats();
+  auto result = Result{};
+  result.m_allocations = globalAllocations() - allocations;
+  result.m_bytes = heap_after.m_bytes - heap.m_bytes;
+  result.m_frame_peak_bytes = world.max_frame_peak_bytes;
+  result.m_coroutine_frames =
+    heap_after.m_coroutine_frames - heap.m_coroutine_frames;
+  result.m_cycles = counts.m_cycles;
+  result.m_instructions = counts.m_instructions;
+  result.m_branch_misses = counts.m_branch_misses;
+  result.m_name = name;
+  result.m_tasks = config.m_tasks;
+  result.m_frames = config.m_frames;
+  result.m_threads = num_threads;
+  result.m_total = world.total();
+  result.m_expected = expected;
+  auto times = world.frame_ns;
+  if (!times.empty()) {
+    for (auto const ns : times) {
+      result.m_total_ns += ns;
+    }
+    std::sort(times.begin(), times.end());
+    auto const n = times.size();
+    result.m_p50_ns = times[n / 2];
+    result.m_p99_ns = times[std::min(n - 1, n * 99 / 100)];
+    result.m_max_ns = times.back();
+    auto const switches = double(config.m_tasks) * config.m_frames;
+    if (switches > 0) result.m_ns_per_switch = result.m_total_ns / switches;
+  }
+  return result;
+}
+
+Result measure(char const* name, Config const& config, Task& task,
+               int64_t expected, int num_threads = 1) {
+  World world(&task);
+  return measureWorld(name, config, world, expected, num_threads);
+}
+
+// MiliTask3Mgr shards advanced by ParallelWorld
+struct Mili3Shards {
+  MiliTask3 m_next_frame;
+  MiliTask3 m_end_coro;
+  ShardedTasks<MiliTask3Mgr> m_sharded;
+
+  Mili3Shards(Config const& config, int num_shards)
+  : m_sharded(config.m_tasks, num_shards,
+              [&config](MiliTask3Mgr& manager, int i) {
+                manager.addTask();
+                manager.tasks.back()->m_worker.position =
+                  startPosition(config, i);
+              }) {
+    next_frame3 = &m_next_frame;
+    end_coro3 = &m_end_coro;
+  }
+
+  std::vector<Task*> shards() const {
+    return m_sharded.shards();
+  }
+};
+}
+
+std::vector<Result> run_suite(Config const& config) {
+  auto const frames = config.m_frames;
+  std::vector<Result> results;
+  std::unique_ptr<cts::ChromeTraceWriter> trace;
+  if (!config.m_trace_path.empty()) {
+    if (cts::Tracer::enabled) {
+      trace = std::make_unique<cts::ChromeTraceWriter>(config.m_trace_path);
+      active_trace = trace.get();
+      // a frame, or a world's setup, is a handful of events per task
+      cts::RingTracer::setCapacity(
+        std::max<size_t>(cts::RingTracer::default_capacity,
+                         size_t(config.m_tasks) * 8));
+    } else {
+      cout << "tracing compiled out, configure with BENCH_TRACE=ON\n";
+    }
+  }
+  if (selected(config, "mili")) {
+    MiliPool pool(config);
+    results.push_back(measure("mili", config, pool,
+      expectedTotal(config, frames, trip_frames)));
+  }
+  if (selected(config, "mili_goto")) {
+    MiliPool<MiliTaskGoto> pool(config);
+    results.push_back(measure("mili_goto", config, pool,
+      expectedTotal(config, frames, trip_frames)));
+  }
+  if (selected(config, "mili_queue")) {
+    Mili2Pool pool(config);
+    results.push_back(measure("mili_queue", config, pool,
+      expectedTotal(config, frames, trip_frames)));
+  }
+  // Dropoff finishes without yielding, so a trip is a frame shorter,
+  // and the first frame only starts the walk to the mine
+  auto const mili3_expected =
+    expectedTotal(config, frames - 1, trip_frames - 1);
+  if (selected(config, "mili_await")) {
+    Mili3Frame<MiliTask3Mgr> world(config);
+    results.push_back(measure("mili_await", config, world, mili3_expected));
+  }
+  if (selected(config, "mili_await_goto")) {
+    Mili3Frame<BasicMiliTask3Mgr<MiliTask3Goto_Main>> world(config);
+    results.push_back(
+      measure("mili_await_goto", config, world, mili3_expected));
+  }
+  if (selected(config, "mili_phased")) {
+    Mili3Frame<MiliTask3PhaseMgr> world(config);
+    results.push_back(
+      measure("mili_phased", config, world, mili3_expected));
+  }
+  if (selected(config, "mili_inline")) {
+    Mili4World world(config);
+    results.push_back(
+      measure("mili_inline", config, world, mili3_expected));
+  }
+  if (selected(config, "mili_pooled")) {
+    Mili4World<MiliTask3PoolMgr> world(config);
+    results.push_back(
+      measure("mili_pooled", config, world, mili3_expected));
+  }
+  if (selected(config, "mili_parallel")) {
+    // shards are fixed so the result does not depend on --threads
+    Mili3Shards shards(config, 64);
+    ParallelWorld world(shards.shards(), config.m_threads);
+    results.push_back(measureWorld("mili_parallel", config, world,
+                                   mili3_expected, world.num_threads));
+  }
+  // spawning runs the first step before the first frame
+  auto const cts_expected = expectedTotal(config, frames + 1, trip_frames);
+  if (selected(config, "cts")) {
+    CtsWorld<> world(config, false);
+    results.push_back(
+      measure("cts", config, world, cts_expected, config.m_threads));
+  }
+  if (selected(config, "cts_phased")) {
+    CtsWorld<> world(config, true);
+    results.push_back(
+      measure("cts_phased", config, world, cts_expected, config.m_threads));
+  }
+  if (selected(config, "cts_events")) {
+    // wakes once per phase, World skips the frames in between
+    CtsWorld<cts::EventMinerTask> world(config, false);
+    results.push_back(
+      measure("cts_events", config, world, cts_expected, config.m_threads));
+  }
+  auto const pool_name = std::string("soa_") + worker_pool_kernel();
+  if (selected(config, pool_name)) {
+    PoolWorld world(config);
+    auto const name = pool_name;
+    results.push_back(measure(name.c_str(), config, world,
+      expectedTotal(config, frames, trip_frames)));
+  }
+  if (trace) {
+    active_trace = nullptr;
+    if (trace->dropped() > 0) {
+      cout << "trace lost " << trace->dropped()
+           << " events to full rings, trace fewer tasks\n";
+    }
+    if (!trace->ok()) cout << "could not write " << config.m_trace_path << "\n";
+  }
+  return results;
+}
+
+void print_results(std::vector<Result> const& results) {
+  auto const counted = std::any_of(results.begin(), results.end(),
+    [](Result const& r) { return r.m_cycles > 0; });
+  cout << std::left << std::setw(14) << "impl" << std::right
+       << std::setw(10) << "ns/switch" << std::setw(10) << "p50 ns"
+       << std::setw(10) << "p99 ns" << std::setw(10) << "max ns"
+       << std::setw(10) << "allocs";
+  if (alloc_stats_enabled) {
+    cout << std::setw(12) << "bytes/frame" << std::setw(12) << "coro/frame"
+         << std::setw(15) << "frame peak KB";
+  }
+  if (counted) cout << std::setw(12) << "miss/switch" << std::setw(6) << "ipc";
+  cout << std::setw(10) << "total" << "\n";
+  for (auto const& r : results) {
+    cout << std::left << std::setw(14) << r.m_name << std::right
+         << std::fixed << std::setprecision(2)
+         << std::setw(10) << r.m_ns_per_switch << std::setw(10) << r.m_p50_ns
+         << std::setw(10) << r.m_p99_ns << std::setw(10) << r.m_max_ns
+         << std::setw(10) << r.m_allocations;
+    if (alloc_stats_enabled) {
+      auto const frames = std::max(1, r.m_frames);
+      cout << std::setw(12) << r.m_bytes / frames << std::setw(12)
+           << double(r.m_coroutine_frames) / frames << std::setw(15)
+           << r.m_frame_peak_bytes / 1024;
+    }
+    if (counted) {
+      auto const switches = double(r.m_tasks) * r.m_frames;
+      auto const ipc = r.m_cycles > 0 ? double(r.m_instructions) / r.m_cycles
+                                      : 0.0;
+      cout << std::setw(12)
+           << (switches > 0 ? r.m_branch_misses / switches : 0.0)
+           << std::setw(6) << ipc;
+    }
+    cout << std::setw(10) << r.m_total;
+    if (r.m_total != r.m_expected) cout << " expected " << r.m_expected;
+    cout << "\n";
+  }
+  if (!counted) cout << "(hardware counters unavailable)\n";
+}
+
+bool write_json(std::string const& path, std::vector<Result> const& results) {
+  std::ofstream out(path);
+  if (!out) return false;
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto const& r = results[i];
+    out << "  {\"impl\": \"" << r.m_name << "\", \"tasks\": " << r.m_tasks
+        << ", \"frames\": " << r.m_frames << ", \"threads\": " << r.m_threads
+        << ", \"total_ns\": " << r.m_total_ns
+        << ", \"ns_per_switch\": " << r.m_ns_per_switch
+        << ", \"p50_ns\": " << r.m_p50_ns << ", \"p99_ns\": " << r.m_p99_ns
+        << ", \"max_ns\": " << r.m_max_ns
+        << ", \"allocations\": " << r.m_allocations
+        << ", \"bytes\": " << r.m_bytes
+        << ", \"frame_peak_bytes\": " << r.m_frame_peak_bytes
+        << ", \"coroutine_frames\": " << r.m_coroutine_frames
+        << ", \"cycles\": " << r.m_cycles
+        << ", \"instructions\": " << r.m_instructions
+        << ", \"branch_misses\": " << r.m_branch_misses
+        << ", \"total\": " << r.m_total << ", \"expected\": " << r.m_expected
+        << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "]\n";
+  return bool(out);
+}
+
+bool write_csv(std::string const& path, std::vector<Result> const& results) {
+  std::ofstream out(path);
+  if (!out) return false;
+  out << "impl,tasks,frames,threads,total_ns,ns_per_switch,p50_ns,p99_ns,"
+         "max_ns,allocations,bytes,frame_peak_bytes,coroutine_frames,cycles,"
+         "instructions,branch_misses,total,expected\n";
+  for (auto const& r : results) {
+    out << r.m_name << "," << r.m_tasks << "," << r.m_frames << ","
+        << r.m_threads << "," << r.m_total_ns << "," << r.m_ns_per_switch
+        << "," << r.m_p50_ns << "," << r.m_p99_ns << "," << r.m_max_ns << ","
+        << r.m_allocations << "," << r.m_bytes << "," << r.m_frame_peak_bytes
+        << "," << r.m_coroutine_frames << "," << r.m_cycles << ","
+        << r.m_instructions
+        << "," << r.m_branch_misses << "," << r.m_total << "," << r.m_expected
+        << "\n";
+  }
+  return bool(out);
+}
+
+void run_examples() {
+  cout << "testing Coroutines TS tasks: \n";
+  cts::run_cts_example();
+  cts::run_task_example();
+  cts::cts_task_benchmark();
+}
+
+void run_micro_benchmarks(Config const& config) {
+  cts::cts_parallel_benchmark(config.m_threads);
+  cts::timing_wheel_benchmark();
+  cts::frame_allocator_benchmark();
+  cts::symmetric_transfer_benchmark();
+  cts::cancellation_benchmark();
+  cts::future_resume_benchmark();
+  cts::generator_benchmark();
+  cts::inbox_benchmark();
+  cts::frame_budget_benchmark();
+  worker_pool_benchmark();
+  parallel_world_benchmark();
+  ring_queue_benchmark();
+  snapshot_benchmark();
+  coroutine_locals_benchmark();
+  cts::trace_summary();
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "scenario.h"
+
+namespace bench {
+
+struct Config {
+  int m_tasks = num_tasks;
+  int m_frames = 10000;
+  int m_threads = 1;
+  // start Worker i i % distance_to_mine steps out, so phases interleave
+  bool m_stagger = false;
+  // run just this implementation, by its result name
+  std::string m_only;
+  std::string m_json_path;
+  std::string m_csv_path;
+  // Chrome trace of the measured frames, needs a CTS_TRACE build
+  std::string m_trace_path;
+};
+
+/**
+ * One implementation driving m_tasks Workers for m_frames frames. A frame
+ * steps every Worker once, so a frame is m_tasks coroutine switches.
+ */
+struct Result {
+  std::string m_name;
+  int m_tasks = 0;
+  int m_frames = 0;
+  int m_threads = 1;
+  int64_t m_total_ns = 0;
+  double m_ns_per_switch = 0;
+  int64_t m_p50_ns = 0;
+  int64_t m_p99_ns = 0;
+  int64_t m_max_ns = 0;
+  // operator new calls while the frames ran, setup excluded
+  int64_t m_allocations = 0;
+  // BENCH_ALLOC_STATS builds only, see alloc_stats.h
+  int64_t m_bytes = 0;
+  // highest live heap bytes within a single frame
+  int64_t m_frame_peak_bytes = 0;
+  int64_t m_coroutine_frames = 0;
+  // hardware counters on the frame loop's thread, zero when unavailable
+  int64_t m_cycles = 0;
+  int64_t m_instructions = 0;
+  int64_t m_branch_misses = 0;
+  int64_t m_total = 0;
+  int64_t m_expected = 0;
+};
+
+// every implementation on the same scenario
+std::vector<Result> run_suite(Config const& config);
+void print_results(std::vector<Result> const& results);
+bool write_json(std::string const& path, std::vector<Result> const& results);
+bool write_csv(std::string const& path, std::vector<Result> const& results);
+
+// the demos and per-feature benchmarks that used to be toggled in main
+void run_examples();
+void run_micro_benchmarks(Config const& config);
+
+// operator new calls so far, counted by alloc_counter.cpp
+int64_t globalAllocations();
+}
@@ -1,18 +1,22 @@
 #include "coroutines_ts.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
 
 namespace cts {
 MyCoro test_fun(MyFuture& fut) {
   cout << "t waiting on future " << &fut << "\n";
-  /* c1 = coroutine_handle
-   * f_a = MyFuture::awaiter(fut) 
+  /* c1 = coroutine_handle(t)
+   * f_a = MyFuture::awaiter(fut)
    * f_a.await_suspend(c1)
-   *   f_a.m_awaiter = c1
-   *   fut.m_list_head = f_a
+   *   f_a.m_slot = fut.m_waiting.size()
+   *   fut.m_waiting.push_back({c1, &f_a})
    */
   co_await fut;
   cout << "t done\n";
-  /* c_p.return_void()
-   * c_h.resume()
+  /* final_awaiter.await_suspend(c1)
+   *   returns c_p.m_continuation (c_h), resumed as a tail call
    */
 }
 
@@ -21,14 +25,17 @@ void run_cts_example() {
   MyFuture fut;
   cout << "run first coroutine\n";
   auto t = test_fun(fut);
+  t.start();
   cout << "t created\n";
   auto const t2 = [](MyCoro& t) -> MyCoro {
     cout << "t2 awaiting on t " << &t << "\n";
-    /* c_p = MyCoro::promise_type(t)
-     * c_a = MyCoro::awaiter(t)
+    /* c_p = t's promise_type
+     * c_a = MyCoro::awaiter(c1)
      * c_h = coroutine_handle(t2)
-     * c1.await_suspend(c_h)
-     *   c_p.m_continuation = c_h
+     * c_a.await_suspend(c_h)
+     *   c_p.awaitedBy(c_h, c1)
+     *     c_p.m_continuation = c_h
+     *     t already started: returns noop_coroutine, t2 stays suspended
      */
     co_await t;
     /* c_a.await_resume()
@@ -36,14 +43,116 @@ void run_cts_example() {
     cout << "t2 done!\n";
   };
   cout << "run second coroutine\n";
-  [[maybe_unused]] auto temp = t2(t);
+  auto temp = t2(t);
+  temp.start();
   cout << "setting future ready\n";
   fut.runTasks();
-  /* f_a.resume()
-   * f_a.await_resume()
+  /* fut.is_ready = true
+   * c1.resume() for each entry of fut.m_waiting, in order
+   *   f_a.await_resume()
    */
   return;
 
 }
 
+MyCoro nested_task(int depth, int64_t& leaves) {
+  if (depth > 0) {
+    co_await nested_task(depth - 1, leaves);
+  } else {
+    ++leaves;
+  }
+}
+
+// relies on the resume being a real tail call: MSVC /O2, GCC -O2 and up
+void symmetric_transfer_benchmark() {
+  constexpr auto depth = 1000000;
+  int64_t leaves = 0;
+  auto const start = std::chrono::high_resolution_clock::now();
+  {
+    auto root = nested_task(depth, leaves);
+    root.start();
+  }
+  auto const endt = std::chrono::high_resolution_clock::now();
+  auto const ns = std::chrono::nanoseconds(endt - start).count();
+  // one hop into each child and one back out of it
+  cout << "awaited " << depth << " nested tasks (" << leaves << " leaf), "
+       << ns / (2 * depth) << " ns per hop\n";
+}
+
+namespace {
+// the intrusive list MyFuture used before, for comparison
+struct list_wait {
+  WaitList & m_list;
+  WaitNode m_node;
+  explicit list_wait(WaitList & list) : m_list(list) {}
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(coroutine_handle<> awaiting) noexcept {
+    m_node.m_awaiter = awaiting;
+    m_list.push_front(m_node);
+  }
+  void await_resume() const noexcept {}
+};
+
+MyCoro wait_on_list(WaitList& list, int64_t& resumed) {
+  co_await list_wait{list};
+  ++resumed;
+}
+
+MyCoro wait_on_future(MyFuture& fut, int64_t& resumed) {
+  co_await fut;
+  ++resumed;
+}
+
+// start in shuffled order so registration order is not address order
+template<typename MakeCoro, typename Release>
+int64_t time_release(int waiters, MakeCoro && make_coro, Release && release) {
+  static std::mt19937 rng(7);
+  std::vector<MyCoro> coros;
+  coros.reserve(waiters);
+  for (auto i = 0; i < waiters; ++i) {
+    coros.push_back(make_coro());
+  }
+  std::vector<MyCoro*> order;
+  for (auto & c : coros) {
+    order.push_back(&c);
+  }
+  std::shuffle(order.begin(), order.end(), rng);
+  for (auto c : order) {
+    c->start();
+  }
+  auto const start = std::chrono::high_resolution_clock::now();
+  release();
+  auto const endt = std::chrono::high_resolution_clock::now();
+  return std::chrono::nanoseconds(endt - start).count();
+}
+}
+
+void future_resume_benchmark() {
+  cout << "MyFuture resume: linked list vs vector\n";
+  constexpr auto rounds = 20;
+  for (auto const waiters : {1000, 10000, 100000}) {
+    int64_t list_ns = 0;
+    int64_t vector_ns = 0;
+    int64_t resumed = 0;
+    for (auto r = 0; r < rounds; ++r) {
+      WaitList list;
+      list_ns += time_release(waiters,
+        [&] { return wait_on_list(list, resumed); },
+        [&] {
+          while (auto const node = list.pop_front()) {
+            Tracer::record(TraceEvent::resume, node->m_awaiter.address());
+            node->m_awaiter.resume();
+          }
+        });
+      MyFuture fut;
+      vector_ns += time_release(waiters,
+        [&] { return wait_on_future(fut, resumed); },
+        [&] { fut.runTasks(); });
+    }
+    auto const count = int64_t{rounds} * waiters;
+    cout << waiters << " waiters: list " << list_ns / count << " ns, vector "
+         << vector_ns / count << " ns per resume (" << resumed << ")\n";
+  }
+}
+
 }
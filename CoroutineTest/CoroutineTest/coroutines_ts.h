@@ -1,158 +1,303 @@
 #pragma once
-#include<experimental/coroutine>
 #include<iostream>
+#include<optional>
+#include<type_traits>
+#include<vector>
+#include "cts_compat.h"
+#include "cts_frame_allocator.h"
+#include "cts_trace.h"
 #include "gsl-lite.hpp"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include<xmmintrin.h>
+#endif
 
 namespace cts {
 using std::cout;
-using std::experimental::coroutine_handle;
-using std::experimental::suspend_always;
-using std::experimental::suspend_never;
 
 /**
- * Generic Future that multiple coroutines may co_await
+ * Intrusive hook for a suspended coroutine. It lives in the coroutine's frame
+ * and unlinks itself when destroyed, so destroying a parked coroutine takes
+ * it off whatever it was waiting on in O(1).
+ */
+struct WaitNode {
+  WaitNode* m_prev{nullptr};
+  WaitNode* m_next{nullptr};
+  coroutine_handle<> m_awaiter;
+  WaitNode() = default;
+  WaitNode(WaitNode const& by_copy) = delete;
+  WaitNode& operator=(WaitNode const& copy) = delete;
+  ~WaitNode() { unlink(); }
+  bool linked() const { return m_prev != nullptr; }
+  void unlink() {
+    if (!linked()) return;
+    m_prev->m_next = m_next;
+    m_next->m_prev = m_prev;
+    m_prev = nullptr;
+    m_next = nullptr;
+  }
+};
+
+/**
+ * Circular doubly linked list of WaitNodes around a sentinel
+ */
+struct WaitList {
+  WaitNode m_head;
+  WaitList() {
+    m_head.m_prev = &m_head;
+    m_head.m_next = &m_head;
+  }
+  WaitList(WaitList const& by_copy) = delete;
+  WaitList& operator=(WaitList const& copy) = delete;
+  ~WaitList() {
+    while (pop_front()) {}
+  }
+  bool empty() const { return m_head.m_next == &m_head; }
+  void push_back(WaitNode & node) {
+    node.m_prev = m_head.m_prev;
+    node.m_next = &m_head;
+    m_head.m_prev->m_next = &node;
+    m_head.m_prev = &node;
+  }
+  void push_front(WaitNode & node) {
+    node.m_prev = &m_head;
+    node.m_next = m_head.m_next;
+    m_head.m_next->m_prev = &node;
+    m_head.m_next = &node;
+  }
+  WaitNode* pop_front() {
+    if (empty()) return nullptr;
+    auto const node = m_head.m_next;
+    node->unlink();
+    return node;
+  }
+  // move every node of other onto the end of this list
+  void splice_back(WaitList & other) {
+    if (other.empty()) return;
+    auto const first = other.m_head.m_next;
+    auto const last = other.m_head.m_prev;
+    first->m_prev = m_head.m_prev;
+    last->m_next = &m_head;
+    m_head.m_prev->m_next = first;
+    m_head.m_prev = last;
+    other.m_head.m_prev = &other.m_head;
+    other.m_head.m_next = &other.m_head;
+  }
+  template<typename F>
+  void forEach(F && f) const {
+    for (auto n = m_head.m_next; n != &m_head; n = n->m_next) f(*n);
+  }
+};
+
+// how many waiters ahead to prefetch when resuming a batch
+constexpr size_t prefetch_distance = 4;
+
+inline void prefetch(void const* address) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_prefetch(static_cast<char const*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+  __builtin_prefetch(address);
+#endif
+}
+
+/**
+ * Generic Future that multiple coroutines may co_await.
+ * Waiters sit in a contiguous vector and are resumed in the order they
+ * registered; a cancelled waiter blanks its own entry in O(1).
  */
 struct MyFuture {
+  struct awaiter;
+  struct Waiter {
+    coroutine_handle<> m_handle;
+    awaiter* m_awaiter;
+  };
+
   struct awaiter {
-    MyFuture & m_future;
-    awaiter* m_next{nullptr}; // linked list
-    coroutine_handle<> m_awaiter;
-    awaiter(MyFuture & future) : m_future(future) {
-      // cout << "constructor ";
-      // printStats();
-    }
+    MyFuture * m_future;
+    size_t m_slot{0};
+    awaiter(MyFuture & future) : m_future(&future) {}
+    awaiter(awaiter const& by_copy) = delete;
+    awaiter& operator=(awaiter const& copy) = delete;
     ~awaiter() {
-      // cout << "destructor ";
-      // printStats();
+      if (!m_future) return;
+      auto & waiting = m_future->m_waiting;
+      if (m_slot < waiting.size() && waiting[m_slot].m_awaiter == this) {
+        waiting[m_slot] = Waiter{nullptr, nullptr};
+      }
     }
-    bool await_ready() const noexcept { return m_future.is_ready; }
+    bool await_ready() const noexcept { return m_future->is_ready; }
     bool await_suspend(coroutine_handle<void> awaiting_task) noexcept {
-      m_awaiter = awaiting_task;
-      if(m_future.is_ready) return false; // run right away
-      // cout << "await suspend on " << awaiting_task.address() << " ";
-      // printStats();
-      m_next = m_future.m_list_head;
-      m_future.m_list_head = this;
-      m_future.printStats();
+      if(m_future->is_ready) return false; // run right away
+      Tracer::record(TraceEvent::suspend, awaiting_task.address(), m_future);
+      m_slot = m_future->m_waiting.size();
+      m_future->m_waiting.push_back(Waiter{awaiting_task, this});
       return true;
     }
-    void await_resume() const noexcept {
-      // cout << "await resume ";
-      // printStats();
-    }
+    void await_resume() const noexcept {}
     void printStats() const {
-      cout << "MyFuture::awaiter[" << this << "] -> " << m_awaiter.address() 
-           << "\n";
+      cout << "MyFuture::awaiter[" << this << "] -> " << m_future << "["
+           << m_slot << "]\n";
     }
   };
 
   bool is_ready{false};
-  awaiter* m_list_head{nullptr};
-  MyFuture() {
-    // cout << "constructor ";
-    // printStats();
-  };
+  std::vector<Waiter> m_waiting;
+  MyFuture() = default;
   MyFuture(MyFuture const& by_copy) = delete;
   MyFuture(MyFuture && by_move) = delete;
   ~MyFuture() {
-    // cout << "Destructor ";
-    // printStats();
+    for (auto const& w : m_waiting) {
+      if (w.m_awaiter) w.m_awaiter->m_future = nullptr;
+    }
   }
   MyFuture& operator=(MyFuture const& copy) = delete;
   MyFuture& operator=(MyFuture && move) = delete;
 
   awaiter operator co_await() noexcept {
-    // cout << "co_await: ";
-    // printStats();
     return awaiter {*this};
   }
   void runTasks() {
     is_ready = true;
-    // cout << "runTasks start ";
-    // printStats();
-    auto current = m_list_head;
-    while (current != nullptr) {
-      auto const next = current->m_next;
-      // cout << "resuming " << current->m_awaiter.address() << "\n";
-      current->m_awaiter.resume();
-      current = next;
-    }
-    m_list_head = current;
-    // cout << "runTasks done ";
-    // printStats();
+    // by index: a resumed task may blank a later entry
+    for (size_t i = 0; i < m_waiting.size(); ++i) {
+      if (i + prefetch_distance < m_waiting.size()) {
+        prefetch(m_waiting[i + prefetch_distance].m_handle.address());
+      }
+      auto const current = m_waiting[i].m_handle;
+      if (!current) continue;
+      Tracer::record(TraceEvent::resume, current.address(), this);
+      current.resume();
+    }
+    m_waiting.clear();
   }
   
   void printStats() {
     cout << "MyFuture[" << this << "]";
-    auto current = m_list_head;
-    while (current != nullptr) {
-      cout << " -> " << current->m_awaiter.address();
-      current = current->m_next;
+    for (auto const& w : m_waiting) {
+      cout << " -> " << w.m_handle.address();
     }
     cout << "\n";
   }
+};
+
+/**
+ * Cooperative cancellation. A task checks stop_requested() when it wakes,
+ * or co_awaits the token to stay parked until a stop is requested.
+ */
+struct StopSource {
+  bool m_stop_requested{false};
+  MyFuture m_on_stop;
+  void request_stop() {
+    if (m_stop_requested) return;
+    m_stop_requested = true;
+    m_on_stop.runTasks();
+  }
+};
+
+struct StopToken {
+  StopSource* m_source{nullptr};
+  bool stop_requested() const {
+    return m_source && m_source->m_stop_requested;
+  }
+  // a token without a source can never be stopped, so awaiting it parks
+  // the task until it is destroyed
+  struct awaiter {
+    std::optional<MyFuture::awaiter> m_on_stop;
+    explicit awaiter(StopSource* source) {
+      if (source) m_on_stop.emplace(source->m_on_stop);
+    }
+    bool await_ready() const noexcept {
+      return m_on_stop && m_on_stop->await_ready();
+    }
+    bool await_suspend(coroutine_handle<void> awaiting_task) noexcept {
+      return !m_on_stop || m_on_stop->await_suspend(awaiting_task);
+    }
+    void await_resume() const noexcept {}
+  };
+  awaiter operator co_await() const noexcept {
+    return awaiter{m_source};
+  }
+};
 
-  bool cancel(coroutine_handle<> coro) {
-    auto did_cancel = false;
-    if (m_list_head->m_awaiter == coro) {
-      m_list_head = m_list_head->m_next;
-      did_cancel = true;
-    }
-    // delete and re-link chain
-    auto current = m_list_head;
-    while (current != nullptr) {
-      auto const prev = current;
-      current = current->m_next;
-      if (!current) break;
-      if (current->m_awaiter == coro) {
-        prev->m_next = current->m_next;
-        did_cancel = true;
+/**
+ * Promise state shared by the lazily started, awaitable coroutine types
+ * (MyCoro, task<T>): who to resume on completion and the stop token.
+ */
+struct ContinuationPromise : FrameAllocated {
+  coroutine_handle<> m_continuation;
+  StopToken m_stop_token;
+  bool m_started{false};
+
+  // stays suspended at the end, the owning object frees the frame
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+    template<typename Promise>
+    coroutine_handle<> await_suspend(
+        coroutine_handle<Promise> done) noexcept {
+      auto const next = done.promise().m_continuation;
+      Tracer::record(TraceEvent::complete, done.address(), next.address());
+      if (next) {
+        Tracer::record(TraceEvent::resume, next.address(), done.address());
+        return next; // tail call, no stack growth
       }
+      return noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  // from an awaiter's await_suspend: remember who is waiting and enter
+  // the awaited coroutine if nothing has started it yet
+  template<typename Promise>
+  coroutine_handle<> awaitedBy(coroutine_handle<Promise> awaiting,
+                               coroutine_handle<> self) noexcept {
+    m_continuation = awaiting;
+    if constexpr (std::is_base_of_v<ContinuationPromise, Promise>) {
+      m_stop_token = awaiting.promise().m_stop_token;
     }
-    m_list_head = current;
-    return did_cancel;
+    Tracer::record(TraceEvent::suspend, awaiting.address(), self.address());
+    if (m_started) return noop_coroutine();
+    m_started = true;
+    Tracer::record(TraceEvent::resume, self.address(), awaiting.address());
+    return self;
   }
 };
 
 /**
- * General-purpose Coroutine class that can both awaited on and resumed
+ * General-purpose Coroutine class that can both awaited on and resumed.
+ * Starts suspended; awaiting it or calling start() runs it. Completion
+ * transfers straight to the awaiting coroutine, so a chain of awaits runs
+ * in constant native stack.
  */
 struct MyCoro {
-  struct promise_type {
-    coroutine_handle<> m_continuation;
+  struct promise_type : ContinuationPromise {
     promise_type() {
-      // cout << "construct "; printStats();
+      Tracer::record(TraceEvent::create, frame());
+    }
+    // a member coroutine gets its object first, which may name the trace
+    template<typename Self, typename... Args>
+    promise_type(Self const& self, Args const&...) : promise_type() {
+      if constexpr (Tracer::enabled && has_trace_name<Self>::value) {
+        Tracer::record(TraceEvent::name, frame(), self.name());
+      }
     }
     ~promise_type() {
-      // cout << "destruct "; printStats();
+      Tracer::record(TraceEvent::destroy, frame());
     }
     MyCoro get_return_object() {
-      auto coro = MyCoro{coroutine_handle<promise_type>::from_promise(*this)};
-      // just shows destructor immediately return by value
-      // cout << "get_return_object = "; coro.printStats(); 
-      // cout << "  from " ; printStats();
-      return coro;
+      return MyCoro{coroutine_handle<promise_type>::from_promise(*this)};
     }
     auto initial_suspend() {
-      // cout << "initial_suspend "; printStats();
-      return suspend_never();
-    }
-    auto final_suspend() {
-      // cout << "final_suspend "; printStats();
-      return suspend_never();
-    }
-    // last chance to resume the awaiting coroutine?
-    void return_void() {
-      // cout << "return_void "; printStats();
-      if (m_continuation) {
-        // cout << "  resuming\n";
-        m_continuation.resume();
-      }
+      return suspend_always();
+    }
+    final_awaiter final_suspend() noexcept {
+      return {};
     }
+    void return_void() {}
     void unhandled_exception() {}
     void set_continuation( coroutine_handle<> coro) {
       m_continuation = coro;
-      // cout << "set_continuation "; printStats();
+    }
+    void const* frame() {
+      return coroutine_handle<promise_type>::from_promise(*this).address();
     }
     void printStats() {
       cout << "promise_type[" << this << "] = " << m_continuation.address() << "\n";
@@ -161,56 +306,53 @@ struct MyCoro {
 
   struct awaiter {
     coroutine_handle<promise_type> m_coro;
-    awaiter(coroutine_handle<promise_type> coro) : m_coro(coro) {
-      // cout << "construct ";
-      // printStats();
-    }
-    ~awaiter() {
-      // cout << "destruct ";
-      // printStats();
-    }
+    awaiter(coroutine_handle<promise_type> coro) : m_coro(coro) {}
     // is it ready to run?
     bool await_ready() const noexcept { return !m_coro || m_coro.done(); }
     // suspends the caller, takes the handle of the
     // coroutine which is executing the co_await, so that it can be resumed
-    // when ready.
-    void await_suspend(coroutine_handle<promise_type> awaiting_coro) noexcept {
-      m_coro.promise().set_continuation(awaiting_coro);
-      // cout << "await_suspend on " << awaiting_coro.address() << " ";
-      // printStats();
+    // when ready. An unstarted child is entered directly.
+    template<typename Promise>
+    coroutine_handle<> await_suspend(
+        coroutine_handle<Promise> awaiting_coro) noexcept {
+      return m_coro.promise().awaitedBy(awaiting_coro, m_coro);
     }
     // get value to return when done
-    void await_resume() noexcept {
-      // cout << "await_resume ";
-      // printStats();
-    }
+    void await_resume() noexcept {}
     void printStats() {
       cout << "MyCoro::awaiter[" << this << "] -> " << m_coro.address() << "\n";
     }
   };
 
   coroutine_handle<promise_type> m_coroutine;  
-  explicit MyCoro(coroutine_handle<promise_type> coro) : m_coroutine(coro) {
-    // cout << "constructor ";
-    // printStats();
-  }
+  explicit MyCoro(coroutine_handle<promise_type> coro) : m_coroutine(coro) {}
   MyCoro(MyCoro const& by_copy) = delete;
-  MyCoro(MyCoro && to_move) = default;
+  MyCoro(MyCoro && to_move) noexcept : m_coroutine(to_move.m_coroutine) {
+    to_move.m_coroutine = nullptr;
+  }
   MyCoro& operator=(MyCoro const& by_copy) = delete;
-  MyCoro& operator=(MyCoro && to_move) = default;
+  MyCoro& operator=(MyCoro && to_move) noexcept {
+    if (&to_move != this) {
+      cancel();
+      m_coroutine = to_move.m_coroutine;
+      to_move.m_coroutine = nullptr;
+    }
+    return *this;
+  }
   ~MyCoro() {
-    // cout << "destructor ";
-    // printStats();
+    cancel();
   }
 
   auto operator co_await() {
-    // cout << "co_await: ";
-    // printStats();
     return awaiter{m_coroutine};
   }
+  // run an unstarted coroutine up to its first suspension
+  void start() {
+    m_coroutine.promise().m_started = true;
+    resume();
+  }
   void resume() {
-    // cout << "resume ";
-    // printStats();
+    Tracer::record(TraceEvent::resume, m_coroutine.address());
     m_coroutine.resume();
   }
   void printStats() {
@@ -220,9 +362,27 @@ struct MyCoro {
   }
 
   void cancel() {
-    m_coroutine.destroy();
+    if (m_coroutine) m_coroutine.destroy();
+    m_coroutine = nullptr;
+  }
+};
+
+/**
+ * `auto token = co_await get_stop_token{};` inside a MyCoro or task<T>
+ * gives the StopToken it was started with.
+ */
+struct get_stop_token {
+  StopToken m_token;
+  bool await_ready() const noexcept { return false; }
+  template<typename Promise>
+  bool await_suspend(coroutine_handle<Promise> self) noexcept {
+    m_token = self.promise().m_stop_token;
+    return false;
   }
+  StopToken await_resume() const noexcept { return m_token; }
 };
 
 void run_cts_example();
+void symmetric_transfer_benchmark();
+void future_resume_benchmark();
 }
\ No newline at end of file
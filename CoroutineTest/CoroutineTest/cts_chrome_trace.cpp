@@ -0,0 +1,118 @@
+#include "cts_chrome_trace.h"
+#include <iomanip>
+
+namespace cts {
+
+ChromeTraceWriter::ChromeTraceWriter(std::string const& path) : m_out(path) {
+  // timestamps are microseconds, keep the nanoseconds
+  m_out << std::fixed << std::setprecision(3);
+  m_out << "{\"traceEvents\":[\n";
+}
+
+ChromeTraceWriter::~ChromeTraceWriter() {
+  flush();
+  m_out << "\n]}\n";
+}
+
+void ChromeTraceWriter::beginProcess(std::string const& name) {
+  // spans left open belong to the previous process
+  m_stacks.clear();
+  m_flows.clear();
+  ++m_pid;
+  separator();
+  m_out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << m_pid
+        << ",\"args\":{\"name\":\"" << name << "\"}}";
+}
+
+void ChromeTraceWriter::flush() {
+  uint64_t dropped = 0;
+  auto const records = RingTracer::collect(&dropped);
+  RingTracer::clear();
+  m_dropped += dropped;
+  for (auto const& r : records) {
+    if (m_base_ns < 0) m_base_ns = r.m_ns;
+    if (r.m_thread >= m_stacks.size()) m_stacks.resize(r.m_thread + 1);
+    auto & stack = m_stacks[r.m_thread];
+    switch (r.m_event) {
+      case TraceEvent::create:
+      case TraceEvent::destroy:
+        // frames are recycled, a name only holds for one lifetime
+        m_names.erase(r.m_coroutine);
+        break;
+      case TraceEvent::name:
+        m_names[r.m_coroutine] = static_cast<char const*>(r.m_related);
+        break;
+      case TraceEvent::resume: {
+        if (!stack.empty()) {
+          // resumed from inside another coroutine: split the outer span
+          span(stack.back(), r.m_ns, r.m_thread, r.m_coroutine);
+        }
+        stack.push_back(Open{r.m_coroutine, r.m_related, r.m_ns});
+        auto const waiting = m_flows.find(r.m_coroutine);
+        if (waiting != m_flows.end()) {
+          flow('f', waiting->second, r.m_ns, r.m_thread);
+          m_flows.erase(waiting);
+        }
+        break;
+      }
+      case TraceEvent::suspend:
+      case TraceEvent::complete: {
+        auto open = stack.end();
+        while (open != stack.begin()) {
+          --open;
+          if (open->m_coroutine == r.m_coroutine) break;
+        }
+        if (open == stack.end() || open->m_coroutine != r.m_coroutine) break;
+        span(*open, r.m_ns, r.m_thread, r.m_related);
+        stack.erase(open, stack.end());
+        // the outer coroutine carries on from here
+        if (!stack.empty()) stack.back().m_start_ns = r.m_ns;
+        if (r.m_event == TraceEvent::complete && r.m_related) {
+          auto const id = m_next_flow++;
+          flow('s', id, r.m_ns, r.m_thread);
+          m_flows[r.m_related] = id;
+        }
+        break;
+      }
+      case TraceEvent::num_events:
+        break;
+    }
+  }
+  m_out.flush();
+}
+
+void ChromeTraceWriter::span(Open const& open, int64_t end_ns,
+                             uint32_t thread, void const* waits_on) {
+  auto const name = m_names.find(open.m_coroutine);
+  separator();
+  m_out << "{\"name\":\""
+        << (name != m_names.end() ? name->second : "coroutine")
+        << "\",\"cat\":\"coroutine\",\"ph\":\"X\",\"ts\":"
+        << micros(open.m_start_ns) << ",\"dur\":"
+        << micros(end_ns) - micros(open.m_start_ns) << ",\"pid\":" << m_pid
+        << ",\"tid\":" << thread << ",\"args\":{\"frame\":\""
+        << open.m_coroutine << "\",\"resumed_by\":\"" << open.m_resumed_by
+        << "\",\"waits_on\":\"" << waits_on << "\"}}";
+}
+
+void ChromeTraceWriter::flow(char phase, uint64_t id, int64_t ns,
+                             uint32_t thread) {
+  separator();
+  m_out << "{\"name\":\"continuation\",\"cat\":\"coroutine\",\"ph\":\""
+        << phase << "\",\"id\":" << id << ",\"ts\":" << micros(ns)
+        << ",\"pid\":" << m_pid << ",\"tid\":" << thread;
+  // the arrow ends on the span the continuation starts
+  if (phase == 'f') m_out << ",\"bp\":\"e\"";
+  m_out << "}";
+}
+
+void ChromeTraceWriter::separator() {
+  if (!m_first) m_out << ",\n";
+  m_first = false;
+}
+
+double ChromeTraceWriter::micros(int64_t ns) const {
+  return static_cast<double>(ns - m_base_ns) / 1000.0;
+}
+
+}
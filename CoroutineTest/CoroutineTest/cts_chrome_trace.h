@@ -0,0 +1,64 @@
+#pragma once
+#include<cstdint>
+#include<fstream>
+#include<string>
+#include<unordered_map>
+#include<vector>
+#include "cts_trace.h"
+
+namespace cts {
+
+/**
+ * Turns RingTracer events into a Chrome trace JSON file for
+ * chrome://tracing or Perfetto. Each resume up to the matching suspend or
+ * completion becomes a span on its thread's track, named by the
+ * coroutine's name event; args carry the frame and what it was resumed
+ * by or waits on, and a flow arrow runs from a finished coroutine to the
+ * continuation it hands over to.
+ *
+ * Recording stays in the rings; flush() converts and empties them, so
+ * call it between frames or at the end of a run. Spans still open at a
+ * flush carry over to the next one.
+ */
+struct ChromeTraceWriter {
+  explicit ChromeTraceWriter(std::string const& path);
+  ChromeTraceWriter(ChromeTraceWriter const& by_copy) = delete;
+  ChromeTraceWriter& operator=(ChromeTraceWriter const& copy) = delete;
+  // flushes and closes the JSON
+  ~ChromeTraceWriter();
+
+  bool ok() const { return m_out.good(); }
+  // start a new process track, e.g. per benchmarked implementation; what
+  // is still in the rings lands on it at the next flush
+  void beginProcess(std::string const& name);
+  void flush();
+  // events the rings overwrote before a flush got to them
+  uint64_t dropped() const { return m_dropped; }
+
+private:
+  struct Open {
+    void const* m_coroutine;
+    void const* m_resumed_by;
+    int64_t m_start_ns;
+  };
+
+  void span(Open const& open, int64_t end_ns, uint32_t thread,
+            void const* waits_on);
+  void flow(char phase, uint64_t id, int64_t ns, uint32_t thread);
+  void separator();
+  double micros(int64_t ns) const;
+
+  std::ofstream m_out;
+  bool m_first = true;
+  int m_pid = 0;
+  int64_t m_base_ns = -1;
+  uint64_t m_dropped = 0;
+  uint64_t m_next_flow = 1;
+  std::unordered_map<void const*, char const*> m_names;
+  // continuation -> flow id, closed when it next resumes
+  std::unordered_map<void const*, uint64_t> m_flows;
+  // per thread, innermost last: a coroutine can resume another directly
+  std::vector<std::vector<Open>> m_stacks;
+};
+
+}
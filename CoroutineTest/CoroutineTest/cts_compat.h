@@ -0,0 +1,22 @@
+#pragma once
+// C++20 <coroutine> where the compiler implements it, the Coroutines TS
+// <experimental/coroutine> otherwise. Everything else names these through
+// cts::.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include<coroutine>
+namespace cts {
+namespace coro = std;
+}
+#else
+#include<experimental/coroutine>
+namespace cts {
+namespace coro = std::experimental;
+}
+#endif
+
+namespace cts {
+using coro::coroutine_handle;
+using coro::noop_coroutine;
+using coro::suspend_always;
+using coro::suspend_never;
+}
@@ -0,0 +1,153 @@
+#include "cts_executor.h"
+#include "cts_frame_allocator.h"
+#include<algorithm>
+#include<iterator>
+
+namespace cts {
+
+thread_local int WorkStealingExecutor::t_worker = 0;
+
+WorkStealingExecutor::WorkStealingExecutor(int num_threads, FrameArena* arena)
+: m_arena(arena) {
+  if (num_threads < 1) num_threads = 1;
+  for (auto i = 0; i < num_threads; ++i) {
+    m_queues.push_back(std::make_unique<WorkQueue>());
+  }
+  // worker 0 is whoever calls runFrame
+  for (auto i = 1; i < num_threads; ++i) {
+    m_threads.emplace_back([this, i] { threadMain(i); });
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(m_frame_lock);
+    m_stopping = true;
+  }
+  m_frame_start.notify_all();
+  for (auto & t : m_threads) {
+    t.join();
+  }
+}
+
+void WorkStealingExecutor::runFrame(
+    std::vector<coroutine_handle<>> const& ready) {
+  if (ready.empty()) return;
+  FrameArena::Scope scope(m_arena);
+  if (m_threads.empty()) {
+    // single threaded: deterministic registration order
+    for (size_t i = 0; i < ready.size(); ++i) {
+      if (i + prefetch_distance < ready.size()) {
+        prefetch(ready[i + prefetch_distance].address());
+      }
+      Tracer::record(TraceEvent::resume, ready[i].address());
+      ready[i].resume();
+    }
+    return;
+  }
+  // deal the handles out in contiguous blocks so neighbours stay together
+  auto const n = m_queues.size();
+  auto const block = (ready.size() + n - 1) / n;
+  for (size_t w = 0; w < n; ++w) {
+    auto const first = std::min(ready.size(), w * block);
+    auto const last = std::min(ready.size(), first + block);
+    m_queues[w]->fill(ready.data() + first, ready.data() + last);
+  }
+  m_pending.store(static_cast<int>(ready.size()));
+  {
+    std::lock_guard<std::mutex> lock(m_frame_lock);
+    ++m_generation;
+    m_busy = static_cast<int>(m_threads.size());
+  }
+  m_frame_start.notify_all();
+  work(0);
+  // barrier: nobody may still be touching this frame's coroutines
+  std::unique_lock<std::mutex> lock(m_frame_lock);
+  m_frame_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+void WorkStealingExecutor::WorkQueue::fill(coroutine_handle<> const* first,
+                                           coroutine_handle<> const* last) {
+  m_slots.assign(std::make_reverse_iterator(last),
+                 std::make_reverse_iterator(first));
+  m_top.store(0, std::memory_order_relaxed);
+  m_bottom.store(static_cast<int64_t>(m_slots.size()),
+                 std::memory_order_relaxed);
+}
+
+bool WorkStealingExecutor::WorkQueue::pop(coroutine_handle<>& out) {
+  auto const bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+  m_bottom.store(bottom, std::memory_order_relaxed);
+  // a thief reading the old bottom must also see the top we read next
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto top = m_top.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  out = m_slots[bottom];
+  if (top < bottom) return true;
+  // the last one: race the thieves for it
+  auto const won = m_top.compare_exchange_strong(
+    top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  return won;
+}
+
+bool WorkStealingExecutor::WorkQueue::steal(coroutine_handle<>& out) {
+  auto top = m_top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto const bottom = m_bottom.load(std::memory_order_acquire);
+  if (top >= bottom) return false;
+  auto const handle = m_slots[top];
+  if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+    return false;
+  }
+  out = handle;
+  return true;
+}
+
+bool WorkStealingExecutor::steal(int thief, coroutine_handle<>& out) {
+  auto const n = threadCount();
+  for (auto i = 1; i < n; ++i) {
+    if (m_queues[(thief + i) % n]->steal(out)) return true;
+  }
+  return false;
+}
+
+void WorkStealingExecutor::work(int worker) {
+  coroutine_handle<> h;
+  while (m_pending.load(std::memory_order_acquire) > 0) {
+    if (m_queues[worker]->pop(h) || steal(worker, h)) {
+      Tracer::record(TraceEvent::resume, h.address());
+      h.resume();
+      m_pending.fetch_sub(1, std::memory_order_acq_rel);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void WorkStealingExecutor::threadMain(int worker) {
+  t_worker = worker;
+  unsigned seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_frame_lock);
+      m_frame_start.wait(lock, [&] {
+        return m_stopping || m_generation != seen;
+      });
+      if (m_stopping) return;
+      seen = m_generation;
+    }
+    {
+      FrameArena::Scope scope(m_arena, worker);
+      work(worker);
+    }
+    std::lock_guard<std::mutex> lock(m_frame_lock);
+    if (--m_busy == 0) m_frame_done.notify_one();
+  }
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include<atomic>
+#include<condition_variable>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include "coroutines_ts.h"
+
+namespace cts {
+struct FrameArena;
+
+/**
+ * Work-stealing executor for the coroutines that become ready in a frame.
+ * Each worker owns a Chase-Lev deque, takes its own block in registration
+ * order from the bottom and steals from the top of the others once its own
+ * is empty, so neither side takes a lock. The thread calling runFrame is
+ * worker 0, so with one thread configured everything runs in order on the
+ * caller.
+ */
+struct WorkStealingExecutor {
+  /**
+   * Deque a frame's handles are dealt into before the workers start; no
+   * pushes happen while they run, so the slots never grow under them and
+   * only the top and bottom indices are shared. The owner pops the bottom,
+   * thieves CAS the top, and the last handle goes to whoever wins the CAS.
+   */
+  struct WorkQueue {
+    std::atomic<int64_t> m_top{0};
+    std::atomic<int64_t> m_bottom{0};
+    // reversed, so popping the bottom walks the block front to back
+    std::vector<coroutine_handle<>> m_slots;
+
+    // between frames only
+    void fill(coroutine_handle<> const* first, coroutine_handle<> const* last);
+    // owner only
+    bool pop(coroutine_handle<>& out);
+    // any worker but the owner
+    bool steal(coroutine_handle<>& out);
+  };
+
+  // frames created while resuming come from arena when one is given
+  explicit WorkStealingExecutor(int num_threads = 1,
+                                FrameArena* arena = nullptr);
+  WorkStealingExecutor(WorkStealingExecutor const& by_copy) = delete;
+  WorkStealingExecutor& operator=(WorkStealingExecutor const& copy) = delete;
+  ~WorkStealingExecutor();
+
+  int threadCount() const { return static_cast<int>(m_queues.size()); }
+  // worker index of the calling thread, 0 for threads outside the pool
+  static int currentWorker() { return t_worker; }
+
+  // resume all handles, returns when every one has suspended again
+  void runFrame(std::vector<coroutine_handle<>> const& ready);
+
+private:
+  bool steal(int thief, coroutine_handle<>& out);
+  void work(int worker);
+  void threadMain(int worker);
+
+  static thread_local int t_worker;
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  std::vector<std::thread> m_threads;
+  FrameArena* m_arena;
+  std::atomic<int> m_pending{0};
+  // frame barrier
+  std::mutex m_frame_lock;
+  std::condition_variable m_frame_start;
+  std::condition_variable m_frame_done;
+  unsigned m_generation = 0;
+  int m_busy = 0;
+  bool m_stopping = false;
+};
+
+}
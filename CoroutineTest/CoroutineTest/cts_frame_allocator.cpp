@@ -0,0 +1,240 @@
+#include "cts_frame_allocator.h"
+#include "alloc_stats.h"
+#include "coroutines_ts.h"
+#include <chrono>
+#include <new>
+#include <thread>
+
+namespace cts {
+
+namespace {
+// remembers where a frame came from so it can go back there
+struct alignas(std::max_align_t) FrameHeader {
+  FrameArena* m_arena;
+};
+
+thread_local FrameArena* t_current_arena = nullptr;
+thread_local int t_current_worker = 0;
+
+size_t classBytes(int size_class) {
+  return static_cast<size_t>(size_class + 1) * FrameArena::granularity;
+}
+}
+
+FrameArena::Scope::Scope(FrameArena* arena, int worker)
+: m_previous(t_current_arena), m_previous_worker(t_current_worker) {
+  t_current_arena = arena;
+  t_current_worker = worker;
+}
+
+FrameArena::Scope::~Scope() {
+  t_current_arena = m_previous;
+  t_current_worker = m_previous_worker;
+}
+
+FrameArena::FrameArena(int num_workers)
+: m_workers(num_workers < 1 ? 1 : num_workers) {}
+
+FrameArena::~FrameArena() {
+  for (auto chunk : m_chunks) {
+    ::operator delete(chunk);
+  }
+}
+
+FrameArena* FrameArena::current() {
+  return t_current_arena;
+}
+
+void* FrameArena::allocate(size_t size) {
+  auto const size_class = sizeClass(size);
+  if (size_class >= num_classes) return ::operator new(size);
+  // only called inside a Scope for this arena, see allocateFrame
+  auto & w = m_workers[t_current_worker % m_workers.size()];
+  ++w.m_allocations;
+  if (w.m_free[size_class] == nullptr) {
+    w.m_free[size_class] =
+      m_returned[size_class].exchange(nullptr, std::memory_order_acquire);
+  }
+  if (auto block = w.m_free[size_class]) {
+    w.m_free[size_class] = block->m_next;
+    ++w.m_reused;
+    return block;
+  }
+  auto const bytes = classBytes(size_class);
+  if (static_cast<size_t>(w.m_bump_end - w.m_bump) < bytes) {
+    auto chunk = static_cast<char*>(::operator new(chunk_size));
+    {
+      std::lock_guard<std::mutex> lock(m_chunk_lock);
+      m_chunks.push_back(chunk);
+    }
+    w.m_bump = chunk;
+    w.m_bump_end = chunk + chunk_size;
+  }
+  auto block = w.m_bump;
+  w.m_bump += bytes;
+  return block;
+}
+
+void FrameArena::deallocate(void* block, size_t size) {
+  auto const size_class = sizeClass(size);
+  if (size_class >= num_classes) {
+    ::operator delete(block);
+    return;
+  }
+  // goes to the freeing worker's list, the chunk stays with the arena
+  auto const free_block = static_cast<FreeBlock*>(block);
+  if (t_current_arena == this) {
+    auto & w = m_workers[t_current_worker % m_workers.size()];
+    free_block->m_next = w.m_free[size_class];
+    w.m_free[size_class] = free_block;
+    return;
+  }
+  auto & returned = m_returned[size_class];
+  free_block->m_next = returned.load(std::memory_order_relaxed);
+  while (!returned.compare_exchange_weak(free_block->m_next, free_block,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {}
+}
+
+FrameArena::Stats FrameArena::stats() const {
+  auto result = Stats{0, 0, 0};
+  for (auto const& w : m_workers) {
+    result.m_allocations += w.m_allocations;
+    result.m_reused += w.m_reused;
+  }
+  result.m_chunks = static_cast<int64_t>(m_chunks.size());
+  return result;
+}
+
+FrameCache& FrameCache::local() {
+  thread_local FrameCache cache;
+  return cache;
+}
+
+FrameCache::~FrameCache() {
+  for (auto & list : m_free) {
+    while (list != nullptr) {
+      auto const next = list->m_next;
+      ::operator delete(list);
+      list = next;
+    }
+  }
+}
+
+void* FrameCache::allocate(size_t size) {
+  auto const size_class = FrameArena::sizeClass(size);
+  if (size_class >= FrameArena::num_classes) {
+    ++m_heap_allocations;
+    return ::operator new(size);
+  }
+  if (m_enabled) {
+    if (auto block = m_free[size_class]) {
+      m_free[size_class] = block->m_next;
+      ++m_reused;
+      return block;
+    }
+  }
+  ++m_heap_allocations;
+  return ::operator new(classBytes(size_class));
+}
+
+void FrameCache::deallocate(void* block, size_t size) {
+  auto const size_class = FrameArena::sizeClass(size);
+  if (!m_enabled || size_class >= FrameArena::num_classes) {
+    ::operator delete(block);
+    return;
+  }
+  auto const free_block = static_cast<FrameArena::FreeBlock*>(block);
+  free_block->m_next = m_free[size_class];
+  m_free[size_class] = free_block;
+}
+
+void* allocateFrame(size_t size) {
+  countCoroutineFrame(size);
+  auto const total = size + sizeof(FrameHeader);
+  auto const arena = FrameArena::current();
+  auto const block = arena ? arena->allocate(total)
+                           : FrameCache::local().allocate(total);
+  auto const header = static_cast<FrameHeader*>(block);
+  header->m_arena = arena;
+  return header + 1;
+}
+
+void deallocateFrame(void* frame, size_t size) {
+  auto const header = static_cast<FrameHeader*>(frame) - 1;
+  auto const total = size + sizeof(FrameHeader);
+  if (header->m_arena) header->m_arena->deallocate(header, total);
+  else FrameCache::local().deallocate(header, total);
+}
+
+namespace {
+MyCoro short_task(MyFuture& fut) {
+  co_await fut;
+}
+
+void spawn_batches(char const* label, FrameArena* arena) {
+  constexpr auto frames = 1000;
+  constexpr auto tasks_per_frame = 1000;
+  auto & cache = FrameCache::local();
+  auto const heap_before = cache.m_heap_allocations;
+  auto const chunks_before = arena ? arena->stats().m_chunks : 0;
+  std::vector<MyCoro> batch;
+  batch.reserve(tasks_per_frame);
+  auto const start = std::chrono::high_resolution_clock::now();
+  for (auto f = 0; f < frames; ++f) {
+    MyFuture fut;
+    FrameArena::Scope scope(arena);
+    for (auto i = 0; i < tasks_per_frame; ++i) {
+      batch.push_back(short_task(fut));
+      batch.back().start();
+    }
+    fut.runTasks();
+    batch.clear();
+  }
+  auto const endt = std::chrono::high_resolution_clock::now();
+  auto const ns = std::chrono::nanoseconds(endt - start).count();
+  auto mallocs = cache.m_heap_allocations - heap_before;
+  if (arena) mallocs += arena->stats().m_chunks - chunks_before;
+  cout << label << ": " << mallocs << " mallocs for "
+       << frames * tasks_per_frame << " frames, "
+       << ns / (frames * tasks_per_frame) << " ns per spawn+run\n";
+}
+
+// frames freed on a thread outside the arena come back through the return
+// list instead of landing on a worker's free list unsynchronised
+void foreign_frees(FrameArena& arena) {
+  constexpr auto frames = 1000;
+  constexpr size_t frame_size = 200;
+  std::vector<void*> blocks(frames);
+  {
+    FrameArena::Scope scope(&arena);
+    for (auto & b : blocks) b = allocateFrame(frame_size);
+  }
+  std::thread([&] {
+    for (auto b : blocks) deallocateFrame(b, frame_size);
+  }).join();
+  auto const before = arena.stats();
+  {
+    FrameArena::Scope scope(&arena);
+    for (auto & b : blocks) b = allocateFrame(frame_size);
+    for (auto b : blocks) deallocateFrame(b, frame_size);
+  }
+  auto const after = arena.stats();
+  cout << "arena: " << after.m_reused - before.m_reused << " of " << frames
+       << " frames freed on another thread reused, "
+       << after.m_chunks - before.m_chunks << " new chunks\n";
+}
+}
+
+void frame_allocator_benchmark() {
+  cout << "coroutine frame allocation\n";
+  auto & cache = FrameCache::local();
+  cache.m_enabled = false;
+  spawn_batches("global new", nullptr);
+  cache.m_enabled = true;
+  spawn_batches("thread cache", nullptr);
+  FrameArena arena;
+  spawn_batches("arena", &arena);
+  foreign_frees(arena);
+}
+}
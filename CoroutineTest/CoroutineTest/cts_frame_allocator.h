@@ -0,0 +1,105 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<vector>
+
+namespace cts {
+
+/**
+ * Size-class slab for coroutine frames, owned by a TaskManager. Each worker
+ * thread carves blocks out of its own chunks and keeps its own free lists,
+ * so only grabbing a fresh chunk takes a lock. A worker is a thread inside
+ * a Scope naming this arena; a frame freed anywhere else (another manager's
+ * thread, or outside any Scope) is pushed onto a lock-free return list,
+ * which a worker takes back whole once its own list runs dry.
+ */
+struct FrameArena {
+  static constexpr size_t granularity = 64;
+  static constexpr int num_classes = 16; // bigger frames use the heap
+  static constexpr size_t chunk_size = 64 * 1024;
+
+  struct FreeBlock {
+    FreeBlock* m_next;
+  };
+  struct WorkerCache {
+    FreeBlock* m_free[num_classes]{};
+    char* m_bump{nullptr};
+    char* m_bump_end{nullptr};
+    int64_t m_allocations{0};
+    int64_t m_reused{0};
+  };
+  struct Stats {
+    int64_t m_allocations;
+    int64_t m_reused;
+    int64_t m_chunks;
+  };
+
+  // makes frames created on this thread come from arena, as its worker
+  struct Scope {
+    FrameArena* m_previous;
+    int m_previous_worker;
+    explicit Scope(FrameArena* arena, int worker = 0);
+    ~Scope();
+    Scope(Scope const& by_copy) = delete;
+    Scope& operator=(Scope const& copy) = delete;
+  };
+
+  explicit FrameArena(int num_workers = 1);
+  FrameArena(FrameArena const& by_copy) = delete;
+  FrameArena& operator=(FrameArena const& copy) = delete;
+  ~FrameArena();
+
+  static FrameArena* current();
+  static int sizeClass(size_t size) {
+    return static_cast<int>((size - 1) / granularity);
+  }
+
+  void* allocate(size_t size);
+  void deallocate(void* block, size_t size);
+  Stats stats() const;
+
+  std::vector<WorkerCache> m_workers;
+  // freed by threads that are not workers of this arena
+  std::atomic<FreeBlock*> m_returned[num_classes]{};
+  std::mutex m_chunk_lock;
+  std::vector<char*> m_chunks;
+};
+
+/**
+ * Thread-local free lists used for frames created outside any arena.
+ * Blocks come from the heap once and are recycled after that.
+ */
+struct FrameCache {
+  FrameArena::FreeBlock* m_free[FrameArena::num_classes]{};
+  int64_t m_heap_allocations{0};
+  int64_t m_reused{0};
+  bool m_enabled{true}; // off: every frame goes straight to the heap
+
+  static FrameCache& local();
+  FrameCache() = default;
+  FrameCache(FrameCache const& by_copy) = delete;
+  FrameCache& operator=(FrameCache const& copy) = delete;
+  ~FrameCache();
+
+  void* allocate(size_t size);
+  void deallocate(void* block, size_t size);
+};
+
+void* allocateFrame(size_t size);
+void deallocateFrame(void* frame, size_t size);
+
+/**
+ * Base for promise types: routes coroutine frame allocation through the
+ * current FrameArena or the thread's FrameCache.
+ */
+struct FrameAllocated {
+  static void* operator new(size_t size) { return allocateFrame(size); }
+  static void operator delete(void* frame, size_t size) {
+    deallocateFrame(frame, size);
+  }
+};
+
+void frame_allocator_benchmark();
+}
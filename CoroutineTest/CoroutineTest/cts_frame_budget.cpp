@@ -0,0 +1,89 @@
+#include "cts_frame_budget.h"
+#include "cts_tasks.h"
+#include <algorithm>
+#include <bit>
+#include <ostream>
+
+namespace cts {
+
+void FrameTimeHistogram::record(int64_t ns) {
+  auto const bucket = ns > 0
+    ? static_cast<int>(std::bit_width(static_cast<uint64_t>(ns))) - 1 : 0;
+  ++m_buckets[std::min(bucket, num_buckets - 1)];
+  ++m_frames;
+  m_max_ns = std::max(m_max_ns, ns);
+}
+
+int64_t FrameTimeHistogram::quantileNs(double q) const {
+  auto const rank = static_cast<int64_t>(q * static_cast<double>(m_frames));
+  int64_t seen = 0;
+  for (auto b = 0; b < num_buckets; ++b) {
+    seen += m_buckets[b];
+    if (seen > rank) return std::min(int64_t{2} << b, m_max_ns);
+  }
+  return m_max_ns;
+}
+
+void FrameTimeHistogram::print(std::ostream& stream) const {
+  for (auto b = 0; b < num_buckets; ++b) {
+    if (m_buckets[b] == 0) continue;
+    stream << "  " << (int64_t{1} << b) / 1000 << "-"
+           << (int64_t{2} << b) / 1000 << " us: " << m_buckets[b] << "\n";
+  }
+}
+
+namespace {
+// stands in for a continuation's game logic
+void burn(int work) {
+  volatile int sink = 0;
+  for (auto i = 0; i < work; ++i) {
+    sink = sink + i;
+  }
+}
+
+MyCoro prioritized(TaskManager& tm, Priority priority, int64_t period,
+                   int work) {
+  while (true) {
+    burn(work);
+    co_await tm.sleepFrames(period, 0, priority);
+  }
+}
+
+// a steady load every frame, plus background work that all wakes at once
+// every 50 frames
+FrameBudgetStats runSpikes(int64_t budget_ns) {
+  constexpr auto frames = 300;
+  constexpr auto work = 100;
+  auto tm = TaskManager{};
+  tm.m_frame_budget_ns = budget_ns;
+  for (auto i = 0; i < 500; ++i) {
+    tm.spawn([&] { return prioritized(tm, Priority::critical, 1, work); });
+  }
+  for (auto i = 0; i < 2000; ++i) {
+    tm.spawn([&] { return prioritized(tm, Priority::normal, 1, work); });
+  }
+  for (auto i = 0; i < 50000; ++i) {
+    tm.spawn([&] { return prioritized(tm, Priority::background, 50, work); });
+  }
+  for (auto f = 0; f < frames; ++f) {
+    tm.nextFrame();
+  }
+  return tm.m_budget_stats;
+}
+}
+
+void frame_budget_benchmark() {
+  cout << "frame budget: 2500 tasks every frame, 50000 background every 50\n";
+  for (auto const budget_ns : {int64_t{0}, int64_t{2000000}}) {
+    auto const stats = runSpikes(budget_ns);
+    auto const& time = stats.m_frame_time;
+    cout << "budget " << budget_ns / 1000 << " us: p50 "
+         << time.quantileNs(0.5) / 1000 << " us, p99 "
+         << time.quantileNs(0.99) / 1000 << " us, max "
+         << time.m_max_ns / 1000 << " us, over budget "
+         << stats.m_frames_over_budget << ", deferred " << stats.m_deferred
+         << ", promoted " << stats.m_promoted << "\n";
+    time.print(cout);
+  }
+}
+}
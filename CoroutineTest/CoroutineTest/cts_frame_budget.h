@@ -0,0 +1,53 @@
+#pragma once
+#include<cstddef>
+#include<cstdint>
+#include<iosfwd>
+
+namespace cts {
+
+/**
+ * How urgently a woken task must run, given to TaskManager::sleepFrames.
+ * Critical and normal continuations always run in the frame they wake in;
+ * background ones run while the frame budget lasts and roll over to the
+ * next frame otherwise. normal is 0 so an untagged TimerNode is normal.
+ */
+enum class Priority : uint8_t {
+  normal = 0,
+  critical = 1,
+  background = 2
+};
+constexpr size_t num_priorities = 3;
+
+// TimerNode::m_priority tag and TaskManager lane for a priority
+constexpr uint8_t priorityIndex(Priority priority) {
+  return static_cast<uint8_t>(priority);
+}
+
+/**
+ * Frame times bucketed by powers of two: bucket b holds frames that took
+ * [2^b, 2^(b+1)) ns, so recording is a count-leading-zeros and an add.
+ */
+struct FrameTimeHistogram {
+  static constexpr int num_buckets = 40;
+  int64_t m_buckets[num_buckets] = {};
+  int64_t m_frames = 0;
+  int64_t m_max_ns = 0;
+
+  void record(int64_t ns);
+  // upper bound of the bucket holding quantile q of the frames
+  int64_t quantileNs(double q) const;
+  void print(std::ostream& stream) const;
+};
+
+// what the budget did, summed since the TaskManager was created
+struct FrameBudgetStats {
+  // background continuations pushed to a later frame, once per frame each
+  int64_t m_deferred = 0;
+  // deferred often enough to run regardless of the budget
+  int64_t m_promoted = 0;
+  int64_t m_frames_over_budget = 0;
+  FrameTimeHistogram m_frame_time;
+};
+
+void frame_budget_benchmark();
+}
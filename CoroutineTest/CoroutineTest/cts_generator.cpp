@@ -0,0 +1,105 @@
+#include "cts_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace cts {
+namespace {
+struct Position {
+  int x;
+  int y;
+};
+
+// unsigned, so large coordinates wrap instead of overflowing
+bool hasOre(Position const& p) {
+  return ((static_cast<uint32_t>(p.x) * 73856093u)
+          ^ (static_cast<uint32_t>(p.y) * 19349663u)) % 97u == 0;
+}
+
+// every tile around center, one row at a time
+std::vector<Position> candidates_vector(Position center, int radius) {
+  std::vector<Position> result;
+  for (auto dy = -radius; dy <= radius; ++dy) {
+    for (auto dx = -radius; dx <= radius; ++dx) {
+      result.push_back(Position{center.x + dx, center.y + dy});
+    }
+  }
+  return result;
+}
+
+generator<Position> candidates(Position center, int radius) {
+  for (auto dy = -radius; dy <= radius; ++dy) {
+    for (auto dx = -radius; dx <= radius; ++dx) {
+      co_yield Position{center.x + dx, center.y + dy};
+    }
+  }
+}
+
+generator<Position> candidate_rows(Position center, int radius) {
+  std::vector<Position> row(2 * radius + 1);
+  for (auto dy = -radius; dy <= radius; ++dy) {
+    for (auto dx = -radius; dx <= radius; ++dx) {
+      row[dx + radius] = Position{center.x + dx, center.y + dy};
+    }
+    co_yield gsl::span<Position>(row);
+  }
+}
+
+template<typename Scan>
+void time_scan(char const* label, Scan && scan) {
+  constexpr auto agents = 1000;
+  constexpr auto frames = 100;
+  constexpr auto radius = 8;
+  int64_t checksum = 0;
+  auto const start = std::chrono::high_resolution_clock::now();
+  for (auto f = 0; f < frames; ++f) {
+    for (auto a = 0; a < agents; ++a) {
+      checksum += scan(Position{a * 31 + f, a * 17 - f}, radius);
+    }
+  }
+  auto const endt = std::chrono::high_resolution_clock::now();
+  auto const ns = std::chrono::nanoseconds(endt - start).count();
+  cout << "  " << label << ": " << ns / (agents * frames)
+       << " ns per agent (" << checksum << ")\n";
+}
+}
+
+void generator_benchmark() {
+  cout << "generator vs vector, first ore tile:\n";
+  time_scan("vector", [](Position c, int r) {
+    auto const tiles = candidates_vector(c, r);
+    auto const it = std::find_if(tiles.begin(), tiles.end(), hasOre);
+    return it == tiles.end() ? 0 : it->x;
+  });
+  time_scan("generator", [](Position c, int r) {
+    auto tiles = candidates(c, r);
+    auto const it = std::find_if(tiles.begin(), tiles.end(), hasOre);
+    return it == tiles.end() ? 0 : it->x;
+  });
+  time_scan("generator rows", [](Position c, int r) {
+    auto tiles = candidate_rows(c, r);
+    auto const it = std::find_if(tiles.begin(), tiles.end(), hasOre);
+    return it == tiles.end() ? 0 : it->x;
+  });
+  cout << "generator vs vector, count all ore tiles:\n";
+  time_scan("vector", [](Position c, int r) {
+    auto const tiles = candidates_vector(c, r);
+    return std::count_if(tiles.begin(), tiles.end(), hasOre);
+  });
+  time_scan("generator", [](Position c, int r) {
+    int64_t count = 0;
+    for (auto const& p : candidates(c, r)) {
+      count += hasOre(p);
+    }
+    return count;
+  });
+  time_scan("generator rows", [](Position c, int r) {
+    int64_t count = 0;
+    for (auto const& p : candidate_rows(c, r)) {
+      count += hasOre(p);
+    }
+    return count;
+  });
+}
+}
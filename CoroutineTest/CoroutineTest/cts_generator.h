@@ -0,0 +1,137 @@
+#pragma once
+#include<cstddef>
+#include<exception>
+#include<iterator>
+#include<memory>
+#include<type_traits>
+#include "coroutines_ts.h"
+#include "gsl-lite.hpp"
+
+namespace cts {
+
+/**
+ * Lazy sequence produced with co_yield. Values are handed out by reference
+ * to the object the generator yielded, nothing is copied. Yielding a
+ * gsl::span hands out each of its elements before the generator resumes.
+ */
+template<typename T>
+struct generator {
+  using value_type = std::remove_cv_t<std::remove_reference_t<T>>;
+  using reference = value_type const&;
+  using pointer = value_type const*;
+
+  struct promise_type : FrameAllocated {
+    // [m_current, m_end) is what the consumer has not seen yet
+    pointer m_current{nullptr};
+    pointer m_end{nullptr};
+    std::exception_ptr m_exception;
+
+    promise_type() {
+      Tracer::record(TraceEvent::create, frame());
+    }
+    ~promise_type() {
+      Tracer::record(TraceEvent::destroy, frame());
+    }
+    void const* frame() {
+      return coroutine_handle<promise_type>::from_promise(*this).address();
+    }
+    generator get_return_object() {
+      return generator{coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    suspend_always initial_suspend() { return {}; }
+    suspend_always final_suspend() noexcept { return {}; }
+    // the yielded object outlives the suspension, so pointing at it is safe
+    suspend_always yield_value(value_type const& value) {
+      m_current = std::addressof(value);
+      m_end = m_current + 1;
+      return {};
+    }
+    suspend_always yield_value(value_type && value) {
+      return yield_value(static_cast<value_type const&>(value));
+    }
+    suspend_always yield_value(gsl::span<value_type const> batch) {
+      m_current = batch.data();
+      m_end = m_current + batch.size();
+      return {};
+    }
+    suspend_always yield_value(gsl::span<value_type> batch) {
+      return yield_value(gsl::span<value_type const>(batch));
+    }
+    void return_void() {}
+    void unhandled_exception() { m_exception = std::current_exception(); }
+    // nothing to resume a generator but its consumer
+    template<typename U>
+    void await_transform(U && value) = delete;
+
+    // run to the next non-empty yield or the end
+    void pull(coroutine_handle<promise_type> self) {
+      do {
+        m_current = m_end = nullptr;
+        Tracer::record(TraceEvent::resume, self.address());
+        self.resume();
+        // yields and the end are plain suspend_always, noted from here
+        Tracer::record(self.done() ? TraceEvent::complete : TraceEvent::suspend,
+                       self.address());
+      } while (!self.done() && m_current == m_end);
+      if (m_exception) std::rethrow_exception(m_exception);
+    }
+  };
+
+  struct iterator {
+    using iterator_category = std::input_iterator_tag;
+    using value_type = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = generator::pointer;
+    using reference = generator::reference;
+
+    coroutine_handle<promise_type> m_coro;
+
+    reference operator*() const { return *m_coro.promise().m_current; }
+    pointer operator->() const { return m_coro.promise().m_current; }
+    iterator& operator++() {
+      auto & promise = m_coro.promise();
+      if (++promise.m_current == promise.m_end) {
+        promise.pull(m_coro);
+        if (m_coro.done()) m_coro = nullptr;
+      }
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(iterator const& other) const {
+      return m_coro == other.m_coro;
+    }
+    bool operator!=(iterator const& other) const { return !(*this == other); }
+  };
+
+  coroutine_handle<promise_type> m_coroutine;
+  explicit generator(coroutine_handle<promise_type> coro)
+  : m_coroutine(coro) {}
+  generator(generator const& by_copy) = delete;
+  generator(generator && to_move) noexcept : m_coroutine(to_move.m_coroutine) {
+    to_move.m_coroutine = nullptr;
+  }
+  generator& operator=(generator const& copy) = delete;
+  generator& operator=(generator && to_move) noexcept {
+    if (&to_move != this) {
+      if (m_coroutine) m_coroutine.destroy();
+      m_coroutine = to_move.m_coroutine;
+      to_move.m_coroutine = nullptr;
+    }
+    return *this;
+  }
+  ~generator() {
+    if (m_coroutine) m_coroutine.destroy();
+  }
+
+  // single pass: begin() runs the generator to its first value
+  iterator begin() {
+    if (!m_coroutine) return end();
+    m_coroutine.promise().pull(m_coroutine);
+    if (m_coroutine.done()) return end();
+    return iterator{m_coroutine};
+  }
+  iterator end() { return iterator{nullptr}; }
+};
+
+void generator_benchmark();
+}
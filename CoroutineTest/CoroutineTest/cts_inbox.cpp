@@ -0,0 +1,131 @@
+#include "cts_inbox.h"
+#include "cts_tasks.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cts {
+
+Inbox::~Inbox() {
+  auto message = m_head.exchange(nullptr, std::memory_order_acquire);
+  while (message) {
+    auto const next = message->m_next;
+    delete message;
+    message = next;
+  }
+}
+
+size_t Inbox::drain() {
+  auto message = m_head.exchange(nullptr, std::memory_order_acquire);
+  // the list is newest first
+  Message* oldest = nullptr;
+  while (message) {
+    auto const next = message->m_next;
+    message->m_next = oldest;
+    oldest = message;
+    message = next;
+  }
+  size_t count = 0;
+  while (oldest) {
+    auto const next = oldest->m_next;
+    oldest->run();
+    delete oldest;
+    oldest = next;
+    ++count;
+  }
+  return count;
+}
+
+namespace {
+struct Increment : Inbox::Message {
+  int64_t& m_counter;
+  explicit Increment(int64_t& counter) : m_counter(counter) {}
+  void run() override { ++m_counter; }
+};
+
+// the obvious alternative: producers and consumer share a lock
+struct LockedInbox {
+  std::mutex m_lock;
+  std::vector<Inbox::Message*> m_messages;
+  std::vector<Inbox::Message*> m_draining;
+  void push(Inbox::Message* message) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_messages.push_back(message);
+  }
+  size_t drain() {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_draining.swap(m_messages);
+    }
+    for (auto message : m_draining) {
+      message->run();
+      delete message;
+    }
+    auto const count = m_draining.size();
+    m_draining.clear();
+    return count;
+  }
+};
+
+// ns per message from first post to last run, the consumer draining in
+// a loop like a frame thread would
+template<typename Queue>
+int64_t nsPerMessage(int producers, int64_t messages) {
+  Queue queue;
+  int64_t counter = 0;
+  auto const start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (auto p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      auto const first = messages * p / producers;
+      auto const last = messages * (p + 1) / producers;
+      for (auto i = first; i < last; ++i) {
+        queue.push(new Increment(counter));
+      }
+    });
+  }
+  while (counter < messages) {
+    if (queue.drain() == 0) std::this_thread::yield();
+  }
+  auto const endt = std::chrono::steady_clock::now();
+  for (auto & t : threads) {
+    t.join();
+  }
+  return std::chrono::nanoseconds(endt - start).count() / messages;
+}
+
+MyCoro wait_for(MyFuture& future, bool& resumed) {
+  co_await future;
+  resumed = true;
+}
+}
+
+void inbox_benchmark() {
+  // a foreign thread spawns a task and completes the future it awaits
+  {
+    auto tm = TaskManager{};
+    MyFuture loaded;
+    auto resumed = false;
+    std::thread io([&] {
+      tm.postSpawn([&] { return wait_for(loaded, resumed); });
+      tm.postComplete(loaded);
+    });
+    io.join();
+    auto const before = resumed;
+    tm.nextFrame();
+    cout << "inbox: future completed from another thread "
+         << (!before && resumed ? "resumed its task" : "FAILED") << "\n";
+    tm.cancelAll();
+  }
+
+  constexpr int64_t messages = 1 << 20;
+  cout << "inbox: " << messages << " posts, ns per message\n";
+  for (auto producers = 1; producers <= 32; producers *= 2) {
+    auto const lock_free = nsPerMessage<Inbox>(producers, messages);
+    auto const locked = nsPerMessage<LockedInbox>(producers, messages);
+    cout << producers << " producers: lock-free " << lock_free
+         << ", mutex " << locked << "\n";
+  }
+}
+}
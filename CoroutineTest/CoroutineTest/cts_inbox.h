@@ -0,0 +1,63 @@
+#pragma once
+#include<atomic>
+#include<cstddef>
+#include<type_traits>
+#include<utility>
+
+namespace cts {
+
+/**
+ * Lock-free multi-producer single-consumer list of callables. Any thread
+ * may post; producers only ever push onto the head with a CAS, and the
+ * consumer takes the whole list with one exchange and reverses it, so it
+ * runs messages in the order each producer posted them. Nothing is
+ * popped concurrently, which is what keeps the push free of ABA.
+ */
+struct Inbox {
+  struct Message {
+    Message* m_next = nullptr;
+    virtual ~Message() = default;
+    virtual void run() = 0;
+  };
+
+  Inbox() = default;
+  Inbox(Inbox const& by_copy) = delete;
+  Inbox& operator=(Inbox const& copy) = delete;
+  // messages never drained are dropped without running
+  ~Inbox();
+
+  // any thread
+  template<typename F>
+  void post(F && f) {
+    push(new Call<std::decay_t<F>>(std::forward<F>(f)));
+  }
+  void push(Message* message) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    do {
+      message->m_next = head;
+    } while (!m_head.compare_exchange_weak(head, message,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+  }
+
+  // consumer thread only: run everything posted so far, returns how many
+  size_t drain();
+  bool empty() const {
+    return m_head.load(std::memory_order_relaxed) == nullptr;
+  }
+
+private:
+  template<typename F>
+  struct Call : Message {
+    F m_f;
+    template<typename G>
+    explicit Call(G && f) : m_f(std::forward<G>(f)) {}
+    void run() override { m_f(); }
+  };
+
+  std::atomic<Message*> m_head{nullptr};
+};
+
+// producers posting into a TaskManager against a mutex-guarded vector
+void inbox_benchmark();
+}
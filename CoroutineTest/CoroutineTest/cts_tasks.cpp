@@ -1,8 +1,46 @@
 #include "cts_tasks.h"
 #include <cassert>
+#include <chrono>
 
 namespace cts {
 
+void TaskManager::runBudgeted(std::chrono::steady_clock::time_point start) {
+  m_ready.clear();
+  for (auto const priority : {Priority::critical, Priority::normal}) {
+    auto & lane = m_lanes[priorityIndex(priority)];
+    m_ready.insert(m_ready.end(), lane.begin(), lane.end());
+    lane.clear();
+  }
+  // carried over from earlier frames; those that waited long enough run
+  // with normal. This frame's arrivals are at the back with no deferrals.
+  for (auto node = m_deferred.m_head.m_next; node != &m_deferred.m_head;) {
+    auto & timer = static_cast<TimerNode&>(*node);
+    node = node->m_next;
+    if (timer.m_deferrals > 0 && timer.m_deferrals >= m_max_deferrals) {
+      timer.unlink();
+      m_ready.push_back(timer.m_awaiter);
+      ++m_budget_stats.m_promoted;
+    }
+  }
+  m_executor.runFrame(m_ready);
+
+  auto const deadline = start + std::chrono::nanoseconds(m_frame_budget_ns);
+  while (!m_deferred.empty()
+         && (m_frame_budget_ns <= 0
+             || std::chrono::steady_clock::now() < deadline)) {
+    // unlinked before they run: resuming a task destroys its TimerNode
+    m_ready.clear();
+    for (size_t i = 0; i < budget_chunk && !m_deferred.empty(); ++i) {
+      m_ready.push_back(m_deferred.pop_front()->m_awaiter);
+    }
+    m_executor.runFrame(m_ready);
+  }
+  m_deferred.forEach([this](WaitNode& node) {
+    ++static_cast<TimerNode&>(node).m_deferrals;
+    ++m_budget_stats.m_deferred;
+  });
+}
+
 struct WorkerTask : Task {  
   WorkerTask(gsl::not_null<TaskManager*> manager) : Task(manager) {}
   MyCoro run() override {
@@ -20,12 +58,120 @@ struct WorkerTask : Task {
 void cts_task_benchmark() {
   auto tm = TaskManager{};
   WorkerTask t(&tm);
-  tm.addTask(t.run());
+  tm.spawn([&] { return t.run(); });
   tm.nextFrame();
   // test cancelling
   tm.cancelAll();
+  cout << "all tasks cancelled!\n";
 
   tm.nextFrame();
   cout << "shouldn't have run \n";
 }
+
+void cts_parallel_benchmark(int num_threads) {
+  cout << "cts work stealing, threads: " << num_threads << "\n";
+  constexpr auto frames = 1000;
+  auto tm = TaskManager{num_threads};
+  std::vector<std::unique_ptr<MinerTask>> miners;
+  for (auto i = 0; i < num_tasks; ++i) {
+    miners.push_back(std::make_unique<MinerTask>(&tm));
+    tm.spawn([&] { return miners.back()->run(); });
+  }
+  auto const start = std::chrono::high_resolution_clock::now();
+  for (auto i = 0; i < frames; ++i) {
+    tm.nextFrame();
+  }
+  auto const endt = std::chrono::high_resolution_clock::now();
+  auto const ns = std::chrono::nanoseconds(endt - start).count();
+  auto total = 0;
+  for (auto const& m : miners) {
+    total += m->m_worker.total;
+  }
+  tm.cancelAll();
+  cout << "Completed trips: " << total << " Time/frame: " << ns / frames
+       << "\n";
+}
+
+MyCoro park_on(MyFuture& fut) {
+  co_await fut;
+}
+
+MyCoro sleep_forever(TaskManager& tm, int64_t frames) {
+  while (true) {
+    co_await tm.sleepFrames(frames);
+  }
+}
+
+MyCoro wait_for_stop(StopToken token, bool& stopped) {
+  co_await token;
+  stopped = true;
+}
+
+MyCoro count_wakes(TaskManager& tm, int& wakes) {
+  while (true) {
+    co_await tm.sleepFrames(1, 0, Priority::background);
+    ++wakes;
+  }
+}
+
+int deferredCount(TaskManager const& tm) {
+  auto count = 0;
+  tm.m_deferred.forEach([&count](WaitNode const&) { ++count; });
+  return count;
+}
+
+// parks tasks across many wheel slots and a shared future, then cancels
+void cancellation_benchmark() {
+  cout << "mass cancellation\n";
+  {
+    // a 1 ns budget defers every background wake; destroying one of them
+    // must take it off the deferred list before the next frame runs it
+    auto tm = TaskManager{};
+    tm.m_frame_budget_ns = 1;
+    auto wakes = 0;
+    for (auto i = 0; i < 4; ++i) {
+      tm.spawn([&] { return count_wakes(tm, wakes); });
+    }
+    tm.nextFrame();
+    auto const deferred = deferredCount(tm);
+    tm.m_tasks.back().m_coro.cancel();
+    auto const left = deferredCount(tm);
+    tm.m_frame_budget_ns = 0;
+    tm.nextFrame();
+    cout << "destroying a deferred task: " << deferred << " deferred, "
+         << left << " after, "
+         << (deferred == 4 && left == 3 && wakes == 3 ? "unlinked" : "MISMATCH")
+         << "\n";
+  }
+  {
+    auto source = StopSource{};
+    auto stopped = false;
+    auto unstopped = false;
+    auto with_source = wait_for_stop(StopToken{&source}, stopped);
+    auto without = wait_for_stop(StopToken{}, unstopped);
+    with_source.start();
+    without.start();
+    source.request_stop();
+    cout << "awaiting a stop token: " << (stopped ? "wakes" : "NEVER WOKE")
+         << " on request_stop, default token "
+         << (unstopped ? "WOKE" : "stays parked") << "\n";
+  }
+  for (auto const count : {10000, 100000, 1000000}) {
+    auto tm = TaskManager{};
+    MyFuture never;
+    for (auto i = 0; i < count; ++i) {
+      if (i % 4 == 0) {
+        tm.spawn([&] { return park_on(never); });
+      } else {
+        tm.spawn([&] { return sleep_forever(tm, 1 + i % 5000); });
+      }
+    }
+    auto const start = std::chrono::high_resolution_clock::now();
+    tm.cancelAll();
+    auto const endt = std::chrono::high_resolution_clock::now();
+    auto const ns = std::chrono::nanoseconds(endt - start).count();
+    cout << count << " parked tasks: " << ns / count << " ns per cancel, "
+         << tm.m_wheels.front().m_count << " left asleep\n";
+  }
+}
 }
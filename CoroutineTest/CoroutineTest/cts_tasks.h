@@ -1,19 +1,21 @@
 #pragma once
-#include<experimental/coroutine>
 #include<iostream>
 #include<algorithm>
 #include<array>
+#include<chrono>
 #include <vector>
 #include "coroutines_ts.h"
+#include "cts_executor.h"
+#include "cts_frame_allocator.h"
+#include "cts_frame_budget.h"
+#include "cts_inbox.h"
+#include "cts_timing_wheel.h"
 #include "scenario.h"
 #include "gsl-lite.hpp"
 
 
 namespace cts {
 using std::cout;
-using std::experimental::coroutine_handle;
-using std::experimental::suspend_always;
-using std::experimental::suspend_never;
 
 struct TaskManager;
 struct Task {
@@ -22,6 +24,8 @@ struct Task {
   virtual ~Task() = default;
   virtual MyCoro run() = 0;
   virtual void cancel() = 0;
+  // labels run()'s spans in traces
+  virtual char const* name() const { return "Task"; }
 };
 
 // need to be able to cancel task and reassign units
@@ -33,49 +37,249 @@ struct TaskUnits {
 
 struct TaskManager {
   static TaskManager* instance;
-  static constexpr auto max_frames = 5;
-  MyFuture m_frames[max_frames];
-  int m_index = 0;
+  // tags for sleepFrames, see m_group_by_phase
+  static constexpr int num_phases = 4;
+  // background continuations resumed between budget checks
+  static constexpr size_t budget_chunk = 64;
+  // declared first: outlives every frame it hands out
+  FrameArena m_arena;
+  WorkStealingExecutor m_executor;
+  // one wheel per worker thread so suspending never contends
+  std::vector<TimingWheel> m_wheels;
   std::vector<TaskUnits> m_tasks;
+  std::vector<coroutine_handle<>> m_ready;
+  // resume woken tasks grouped by the phase they slept with, so the same
+  // continuation runs back to back
+  bool m_group_by_phase = false;
+  std::vector<TimerNode*> m_phase_ready[num_phases];
+  // 0 resumes everything that wakes; otherwise background continuations
+  // that would run past this many ns after the frame started wait
+  int64_t m_frame_budget_ns = 0;
+  // frames a background continuation may wait before it runs regardless
+  int m_max_deferrals = 8;
+  FrameBudgetStats m_budget_stats;
+  // this frame's woken tasks by Priority, filled while budgeted
+  std::vector<coroutine_handle<>> m_lanes[num_priorities];
+  // woken background continuations waiting for budget, oldest first. Their
+  // TimerNodes stay linked here until resumed, so a task destroyed while
+  // deferred unlinks itself like one destroyed asleep.
+  WaitList m_deferred;
+  StopSource m_stop;
+  // work posted from other threads, run at the start of nextFrame
+  Inbox m_inbox;
+
+  explicit TaskManager(int num_threads = 1)
+  : m_arena(num_threads), m_executor(num_threads, &m_arena),
+    m_wheels(m_executor.threadCount()) {}
 
   void addTask(MyCoro&& coro) {
     m_tasks.emplace_back(std::move(coro));
+    auto & task = m_tasks.back().m_coro;
+    task.m_coroutine.promise().m_stop_token = StopToken{&m_stop};
+    task.start();
+  }
+
+  // create the task with its frame in this manager's arena
+  template<typename MakeCoro>
+  void spawn(MakeCoro && make_coro) {
+    FrameArena::Scope scope(&m_arena);
+    addTask(make_coro());
+  }
+
+  // from any thread: run f on the frame thread when the next frame starts
+  template<typename F>
+  void post(F && f) {
+    m_inbox.post(std::forward<F>(f));
+  }
+
+  // from any thread: spawn a task when the next frame starts
+  template<typename MakeCoro>
+  void postSpawn(MakeCoro && make_coro) {
+    post([this, make = std::forward<MakeCoro>(make_coro)]() mutable {
+      spawn(make);
+    });
+  }
+
+  // from any thread: resume the future's waiters when the next frame
+  // starts; MyFuture itself is only touched on the frame thread
+  void postComplete(MyFuture& future) {
+    post([&future] { future.runTasks(); });
   }
 
-  int getIndex(int n) const {
-    return (m_index + n) % max_frames;
+  int64_t frame() const {
+    return m_wheels.front().m_now;
   }
 
   void nextFrame() {
-    cout << "next frame\n";
-    ++m_index;
-    auto& frame = gsl::at(m_frames, m_index);
-    frame.runTasks();
+    auto const start = std::chrono::steady_clock::now();
+    if (!m_inbox.empty()) {
+      // posted work may resume or create tasks, keep their frames local
+      FrameArena::Scope scope(&m_arena);
+      m_inbox.drain();
+    }
+    m_ready.clear();
+    if (m_frame_budget_ns > 0 || !m_deferred.empty()) {
+      wake([this](TimerNode& node) {
+        if (node.m_priority == priorityIndex(Priority::background)) {
+          node.m_deferred = true;
+          node.m_deferrals = 0;
+          m_deferred.push_back(node);
+        } else {
+          m_lanes[node.m_priority].push_back(node.m_awaiter);
+        }
+      });
+      runBudgeted(start);
+    } else {
+      wake([this](TimerNode& node) { m_ready.push_back(node.m_awaiter); });
+      m_executor.runFrame(m_ready);
+    }
+    auto const ns = std::chrono::nanoseconds(
+      std::chrono::steady_clock::now() - start).count();
+    m_budget_stats.m_frame_time.record(ns);
+    if (m_frame_budget_ns > 0 && ns > m_frame_budget_ns) {
+      ++m_budget_stats.m_frames_over_budget;
+    }
+  }
+
+  // first frame in which some task wakes up, TimingWheel::never if none
+  int64_t nextEventFrame() const {
+    if (!m_deferred.empty()) return frame() + 1;
+    auto next = TimingWheel::never;
+    for (auto const& wheel : m_wheels) {
+      next = std::min(next, wheel.nextEventFrame());
+    }
+    return next;
+  }
+
+  // pass frames in which no task would run, see TimingWheel::skip
+  void skipFrames(int64_t frames) {
+    for (auto & wheel : m_wheels) {
+      wheel.skip(frames);
+    }
+  }
+
+  // wait for n frames; phase must be below num_phases
+  TimingWheel::awaiter sleepFrames(int64_t n = 1, uint8_t phase = 0,
+                                   Priority priority = Priority::normal) {
+    auto & wheel = m_wheels[WorkStealingExecutor::currentWorker()];
+    return TimingWheel::awaiter{wheel, n, phase, priorityIndex(priority)};
   }
 
-  // wait for n frames
-  MyFuture & sleepFrames(int n = 1) {
-    const auto i = getIndex(n);
-    cout << "awaiting frame index " << i << std::endl;
-    auto & frame = m_frames[i];//gsl::at(m_frames, i);//
-    return frame;
+  // ask tasks to finish on their own, see StopToken
+  void requestStop() {
+    m_stop.request_stop();
   }
 
   void cancelAll() {
     for(auto & tu : m_tasks) {
-      cout << "cancelling "; tu.m_coro.printStats();
-      for(auto & f : m_frames) {
-        if(f.m_list_head) {
-          cout << "cancel2 "; f.printStats();
-          f.cancel(tu.m_coro.m_coroutine.promise().m_continuation);
+      // deleting the frame unlinks whatever it is parked on
+      tu.m_coro.cancel();
+    }
+    m_tasks.clear();
+  }
+
+private:
+  // advance the wheels and hand place every task that wakes this frame
+  template<typename Place>
+  void wake(Place && place) {
+    if (m_group_by_phase) {
+      for (auto & wheel : m_wheels) {
+        wheel.advance([this](TimerNode& node) {
+          // the node lives in the sleeping frame until it is resumed
+          m_phase_ready[node.m_phase].push_back(&node);
+        });
+      }
+      for (auto & bucket : m_phase_ready) {
+        for (auto node : bucket) {
+          place(*node);
         }
+        bucket.clear();
+      }
+    } else {
+      for (auto & wheel : m_wheels) {
+        wheel.advance(place);
       }
-      tu.m_coro.cancel(); // delete coroutine frame
     }
-    m_tasks.clear();
-    cout << "all tasks cancelled!\n";
+  }
+
+  // critical and normal lanes, then background until the budget is spent
+  void runBudgeted(std::chrono::steady_clock::time_point start);
+};
+
+// the scenario Worker, one step per frame
+struct MinerTask : Task {
+  // where each sleep resumes, for TaskManager::m_group_by_phase
+  enum Phase : uint8_t { to_mine, mining, to_home };
+  Worker m_worker;
+  MinerTask(gsl::not_null<TaskManager*> manager) : Task(manager) {}
+  char const* name() const override { return "MinerTask"; }
+  MyCoro run() override {
+    while(true) {
+      while (!m_worker.atMine()) {
+        m_worker.moveMine();
+        co_await m_manager->sleepFrames(1, to_mine);
+      }
+      do {
+        m_worker.gather();
+        co_await m_manager->sleepFrames(1, mining);
+      } while (m_worker.isMining());
+      while (!m_worker.atHome()) {
+        m_worker.moveHome();
+        co_await m_manager->sleepFrames(1, to_home);
+      }
+      m_worker.dropoff();
+      co_await m_manager->sleepFrames(1, to_mine);
+    }
+  }
+
+  void cancel() override {
+
+  }
+};
+
+/**
+ * MinerTask that sleeps through whole phases instead of waking every
+ * frame. Worker moves are deterministic, so a phase is stepped through at
+ * once and the task sleeps for as many frames as those steps take; the
+ * dropoff lands on the same frame as MinerTask's.
+ */
+struct EventMinerTask : Task {
+  Worker m_worker;
+  EventMinerTask(gsl::not_null<TaskManager*> manager) : Task(manager) {}
+  char const* name() const override { return "EventMinerTask"; }
+  MyCoro run() override {
+    // frames the steps taken so far account for
+    int64_t frames = 0;
+    while(true) {
+      while (!m_worker.atMine()) {
+        m_worker.moveMine();
+        ++frames;
+      }
+      co_await m_manager->sleepFrames(frames);
+      frames = 0;
+      do {
+        m_worker.gather();
+        ++frames;
+      } while (m_worker.isMining());
+      co_await m_manager->sleepFrames(frames);
+      frames = 0;
+      while (!m_worker.atHome()) {
+        m_worker.moveHome();
+        ++frames;
+      }
+      co_await m_manager->sleepFrames(frames);
+      // the dropoff takes a frame of its own, folded into the next walk
+      m_worker.dropoff();
+      frames = 1;
+    }
+  }
+
+  void cancel() override {
+
   }
 };
 
 void cts_task_benchmark();
+void cts_parallel_benchmark(int num_threads);
+void cancellation_benchmark();
 }
@@ -0,0 +1,38 @@
+#include "cts_timing_wheel.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace cts {
+using std::cout;
+
+void timing_wheel_benchmark() {
+  using clock = std::chrono::high_resolution_clock;
+  cout << "timing wheel: schedule/expire\n";
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> delays(1, 100000);
+  std::vector<coroutine_handle<>> expired;
+  for (auto const sleepers : {10000, 100000, 1000000}) {
+    std::vector<TimerNode> nodes(sleepers);
+    TimingWheel wheel;
+    auto const start = clock::now();
+    for (auto & node : nodes) {
+      wheel.schedule(node, delays(rng));
+    }
+    auto const scheduled = clock::now();
+    int64_t count = 0;
+    while (wheel.m_count > 0) {
+      expired.clear();
+      wheel.advance(expired);
+      count += static_cast<int64_t>(expired.size());
+    }
+    auto const endt = clock::now();
+    auto const schedule_ns =
+      std::chrono::nanoseconds(scheduled - start).count();
+    auto const expire_ns = std::chrono::nanoseconds(endt - scheduled).count();
+    cout << sleepers << " sleepers: schedule " << schedule_ns / sleepers
+         << " ns, expire " << expire_ns / count << " ns over "
+         << wheel.m_now << " frames\n";
+  }
+}
+}
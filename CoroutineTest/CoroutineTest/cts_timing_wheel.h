@@ -0,0 +1,170 @@
+#pragma once
+#include<bit>
+#include<cstdint>
+#include<limits>
+#include<vector>
+#include "coroutines_ts.h"
+
+namespace cts {
+
+/**
+ * A coroutine waiting for a frame. Embedded in the awaiter, so it lives in
+ * the sleeping coroutine's frame and scheduling never allocates.
+ */
+struct TimerNode : WaitNode {
+  int64_t m_deadline{0};
+  // caller's tags, let the scheduler group and order what it resumes
+  uint8_t m_phase{0};
+  uint8_t m_priority{0};
+  // kept on by the scheduler after it expired, e.g. in TaskManager's
+  // m_deferred; the wheel no longer counts it
+  bool m_deferred{false};
+  // frames a deferred node has been passed over for lack of budget
+  int m_deferrals{0};
+};
+
+/**
+ * Hierarchical timing wheel counting in frames. Level L has 256 slots that
+ * are each 256^L frames wide; a slot of an upper level is cascaded down when
+ * the level below wraps. Insert and expiry are O(1) for any delay.
+ * A bitmap per level marks slots that may hold nodes, so the next frame
+ * with anything to do is found without stepping through empty ones.
+ */
+struct TimingWheel {
+  static constexpr int slot_bits = 8;
+  static constexpr int num_slots = 1 << slot_bits;
+  static constexpr int slot_mask = num_slots - 1;
+  static constexpr int num_levels = 4;
+  static constexpr int bitmap_words = num_slots / 64;
+  static constexpr int64_t never = std::numeric_limits<int64_t>::max();
+
+  struct awaiter : TimerNode {
+    TimingWheel & m_wheel;
+    int64_t m_delay;
+    awaiter(TimingWheel & wheel, int64_t delay, uint8_t phase = 0,
+            uint8_t priority = 0)
+    : m_wheel(wheel), m_delay(delay) {
+      m_phase = phase;
+      m_priority = priority;
+    }
+    // destroyed while asleep: the task was cancelled
+    ~awaiter() {
+      if (linked() && !m_deferred) --m_wheel.m_count;
+    }
+    bool await_ready() const noexcept { return m_delay <= 0; }
+    void await_suspend(coroutine_handle<> awaiting) noexcept {
+      m_awaiter = awaiting;
+      Tracer::record(TraceEvent::suspend, awaiting.address(), &m_wheel);
+      m_wheel.schedule(*this, m_delay);
+    }
+    void await_resume() const noexcept {}
+  };
+
+  WaitList m_slots[num_levels][num_slots];
+  // set on insert, cleared when the slot is processed; a cancelled sleeper
+  // can leave a bit set, which only costs an early wake-up
+  uint64_t m_occupied[num_levels][bitmap_words] = {};
+  int64_t m_now = 0;
+  int64_t m_count = 0;
+
+  // delay must be at least one frame
+  void schedule(TimerNode & node, int64_t delay) {
+    node.m_deadline = m_now + delay;
+    insert(node);
+    ++m_count;
+  }
+
+  // step to the next frame and append whatever expires to out
+  void advance(std::vector<coroutine_handle<>>& out) {
+    advance([&out](TimerNode& node) { out.push_back(node.m_awaiter); });
+  }
+
+  // step to the next frame and hand each expired node to on_expired
+  template<typename OnExpired>
+  void advance(OnExpired && on_expired) {
+    ++m_now;
+    for (auto level = 1; level < num_levels; ++level) {
+      auto const shift = slot_bits * level;
+      if ((m_now & ((int64_t{1} << shift) - 1)) != 0) break;
+      cascade(level, static_cast<int>((m_now >> shift) & slot_mask));
+    }
+    auto const index = static_cast<int>(m_now & slot_mask);
+    clearOccupied(0, index);
+    auto & slot = m_slots[0][index];
+    while (auto const node = slot.pop_front()) {
+      --m_count;
+      on_expired(static_cast<TimerNode&>(*node));
+    }
+  }
+
+  // first frame after m_now at which a node may expire or be cascaded
+  int64_t nextEventFrame() const {
+    if (m_count == 0) return never;
+    auto next = never;
+    for (auto level = 0; level < num_levels; ++level) {
+      // frames at this level are counted in slot-sized units
+      auto const shift = slot_bits * level;
+      auto const unit = (m_now >> shift) + 1;
+      auto const distance = nextOccupied(level, unit & slot_mask);
+      if (distance < 0) continue;
+      auto const frame = (unit + distance) << shift;
+      if (frame < next) next = frame;
+    }
+    return next;
+  }
+
+  // jump over frames in which nothing happens, m_now + frames must be
+  // before nextEventFrame()
+  void skip(int64_t frames) {
+    m_now += frames;
+  }
+
+private:
+  void insert(TimerNode & node) {
+    auto const delta = node.m_deadline - m_now;
+    auto level = 0;
+    while (level < num_levels - 1
+           && delta >= (int64_t{1} << (slot_bits * (level + 1)))) {
+      ++level;
+    }
+    auto const index =
+      static_cast<int>((node.m_deadline >> (slot_bits * level)) & slot_mask);
+    m_slots[level][index].push_back(node);
+    m_occupied[level][index / 64] |= uint64_t{1} << (index % 64);
+  }
+
+  void cascade(int level, int index) {
+    // detach first, a far deadline can land back in the same slot
+    WaitList pending;
+    pending.splice_back(m_slots[level][index]);
+    clearOccupied(level, index);
+    while (auto const node = pending.pop_front()) {
+      insert(static_cast<TimerNode&>(*node));
+    }
+  }
+
+  void clearOccupied(int level, int index) {
+    m_occupied[level][index / 64] &= ~(uint64_t{1} << (index % 64));
+  }
+
+  // slots from `from` to the next marked one, wrapping round; -1 if none
+  int nextOccupied(int level, int from) const {
+    auto const& bits = m_occupied[level];
+    for (auto i = 0; i <= bitmap_words; ++i) {
+      auto const word = (from / 64 + i) % bitmap_words;
+      auto mask = bits[word];
+      // the first word is only searched from `from`, the wrap-around visit
+      // covers the part before it
+      if (i == 0) mask &= ~uint64_t{0} << (from % 64);
+      if (i == bitmap_words) mask &= ~(~uint64_t{0} << (from % 64));
+      if (mask != 0) {
+        auto const index = word * 64 + std::countr_zero(mask);
+        return (index - from) & slot_mask;
+      }
+    }
+    return -1;
+  }
+};
+
+void timing_wheel_benchmark();
+}
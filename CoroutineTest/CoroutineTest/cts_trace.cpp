@@ -0,0 +1,89 @@
+#include "cts_trace.h"
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace cts {
+
+namespace {
+// taken once per thread, when it records its first event
+std::mutex& ringsLock() {
+  static std::mutex lock;
+  return lock;
+}
+std::vector<std::unique_ptr<RingTracer::Ring>>& rings() {
+  static std::vector<std::unique_ptr<RingTracer::Ring>> all;
+  return all;
+}
+// guarded by ringsLock
+size_t g_capacity = RingTracer::default_capacity;
+
+void resize(RingTracer::Ring& ring) {
+  ring.m_records.assign(g_capacity, TraceRecord{});
+  ring.m_mask = g_capacity - 1;
+  ring.m_written.store(0, std::memory_order_relaxed);
+}
+}
+
+RingTracer::Ring* RingTracer::registerThread() {
+  std::lock_guard<std::mutex> lock(ringsLock());
+  auto & all = rings();
+  all.push_back(std::make_unique<Ring>());
+  resize(*all.back());
+  all.back()->m_thread = static_cast<uint32_t>(all.size() - 1);
+  return all.back().get();
+}
+
+std::vector<TraceRecord> RingTracer::collect(uint64_t* dropped) {
+  std::vector<TraceRecord> records;
+  if (dropped) *dropped = 0;
+  std::lock_guard<std::mutex> lock(ringsLock());
+  for (auto const& ring : rings()) {
+    auto const written = ring->m_written.load(std::memory_order_acquire);
+    auto const size = ring->m_records.size();
+    auto const first = written > size ? written - size : 0;
+    if (dropped) *dropped += first;
+    for (auto n = first; n < written; ++n) {
+      records.push_back(ring->m_records[n & ring->m_mask]);
+    }
+  }
+  std::stable_sort(records.begin(), records.end(),
+    [](TraceRecord const& a, TraceRecord const& b) { return a.m_ns < b.m_ns; });
+  return records;
+}
+
+void RingTracer::clear() {
+  std::lock_guard<std::mutex> lock(ringsLock());
+  for (auto const& ring : rings()) {
+    ring->m_written.store(0, std::memory_order_relaxed);
+  }
+}
+
+void RingTracer::setCapacity(size_t events) {
+  std::lock_guard<std::mutex> lock(ringsLock());
+  g_capacity = std::bit_ceil(std::max<size_t>(events, 1));
+  for (auto const& ring : rings()) {
+    resize(*ring);
+  }
+}
+
+void trace_summary() {
+  if (!Tracer::enabled) {
+    std::cout << "tracing compiled out, configure with BENCH_TRACE=ON\n";
+    return;
+  }
+  int64_t counts[static_cast<int>(TraceEvent::num_events)] = {};
+  for (auto const& r : RingTracer::collect()) {
+    ++counts[static_cast<int>(r.m_event)];
+  }
+  static char const* const names[] = {
+    "create", "resume", "suspend", "complete", "destroy", "name"};
+  std::cout << "trace events kept:";
+  for (auto e = 0; e < static_cast<int>(TraceEvent::num_events); ++e) {
+    std::cout << " " << names[e] << " " << counts[e];
+  }
+  std::cout << "\n";
+}
+}
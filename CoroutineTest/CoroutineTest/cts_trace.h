@@ -0,0 +1,106 @@
+#pragma once
+#include<atomic>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+namespace cts {
+
+enum class TraceEvent : uint8_t {
+  create,   // promise constructed
+  resume,   // about to resume the coroutine
+  suspend,  // parked on m_related (a future, wheel or awaited coroutine)
+  complete, // reached final_suspend, m_related is the continuation
+  destroy,  // promise destroyed
+  name,     // m_related is a static string naming the coroutine
+  num_events
+};
+
+struct TraceRecord {
+  int64_t m_ns;
+  // the coroutine's frame
+  void const* m_coroutine;
+  void const* m_related;
+  uint32_t m_thread;
+  TraceEvent m_event;
+};
+
+/**
+ * Tracing policy that records nothing. Every hook is an empty inline
+ * function, so a build without CTS_TRACE carries no trace code at all.
+ */
+struct NullTracer {
+  static constexpr bool enabled = false;
+  static void record(TraceEvent, void const*, void const* = nullptr) noexcept {}
+};
+
+/**
+ * Tracing policy that appends to a ring buffer owned by the calling
+ * thread: no locks and no sharing on the hot path, the newest capacity()
+ * events per thread survive. The rings are meant to hold one frame and be
+ * drained between frames, see ChromeTraceWriter::flush. Rings live until
+ * exit, so collect() still sees threads that have finished.
+ */
+struct RingTracer {
+  static constexpr bool enabled = true;
+  static constexpr size_t default_capacity = size_t{1} << 16;
+
+  struct Ring {
+    std::vector<TraceRecord> m_records;
+    uint64_t m_mask = 0;
+    // only the owning thread writes; count of events ever recorded
+    std::atomic<uint64_t> m_written{0};
+    uint32_t m_thread = 0;
+  };
+
+  static void record(TraceEvent event, void const* coroutine,
+                     void const* related = nullptr) noexcept {
+    auto & ring = local();
+    auto const n = ring.m_written.load(std::memory_order_relaxed);
+    ring.m_records[n & ring.m_mask] =
+      TraceRecord{now(), coroutine, related, ring.m_thread, event};
+    ring.m_written.store(n + 1, std::memory_order_release);
+  }
+
+  // every thread's surviving events, oldest first; call while no
+  // coroutines run, e.g. between frames. dropped counts the overwritten.
+  static std::vector<TraceRecord> collect(uint64_t* dropped = nullptr);
+  // forget everything recorded so far
+  static void clear();
+  // events each ring keeps, rounded up to a power of two; applies to the
+  // existing rings too, which it empties, so call while nothing records
+  static void setCapacity(size_t events);
+
+private:
+  static Ring& local() {
+    thread_local Ring* ring = nullptr;
+    if (!ring) ring = registerThread();
+    return *ring;
+  }
+  static Ring* registerThread();
+  static int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+
+// T has `char const* name() const`, for naming a coroutine by its object
+template<typename T, typename = void>
+struct has_trace_name : std::false_type {};
+template<typename T>
+struct has_trace_name<T, std::void_t<decltype(
+  static_cast<char const*>(std::declval<T const&>().name()))>>
+  : std::true_type {};
+
+#if defined(CTS_TRACE)
+using Tracer = RingTracer;
+#else
+using Tracer = NullTracer;
+#endif
+
+// events recorded so far by kind, or a note that tracing is compiled out
+void trace_summary();
+}
@@ -0,0 +1,47 @@
+#include "cts_value_task.h"
+#include "cts_tasks.h"
+#include <stdexcept>
+
+namespace cts {
+namespace {
+struct Path {
+  std::vector<int> m_steps;
+};
+
+// spread over a few frames the way a real search would be
+task<Path> find_path(TaskManager& tm, int from, int to) {
+  if (from == to) throw std::runtime_error("already there");
+  Path path;
+  auto const dir = to > from ? 1 : -1;
+  for (auto p = from; p != to; p += dir) {
+    path.m_steps.push_back(p + dir);
+    if (path.m_steps.size() % 4 == 0) co_await tm.sleepFrames();
+  }
+  co_return path;
+}
+
+task<int> trip_length(TaskManager& tm, int position) {
+  auto const path = co_await find_path(tm, position, distance_to_mine);
+  co_return static_cast<int>(path.m_steps.size()) * 2;
+}
+
+MyCoro agent(TaskManager& tm) {
+  auto const frames = co_await trip_length(tm, 0);
+  cout << "round trip to the mine: " << frames << " frames\n";
+  try {
+    co_await trip_length(tm, distance_to_mine);
+  } catch (std::exception const& e) {
+    cout << "no trip: " << e.what() << "\n";
+  }
+}
+}
+
+void run_task_example() {
+  TaskManager tm;
+  tm.spawn([&] { return agent(tm); });
+  for (auto i = 0; i < 5; ++i) {
+    tm.nextFrame();
+  }
+  tm.cancelAll();
+}
+}
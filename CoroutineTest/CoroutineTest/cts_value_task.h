@@ -0,0 +1,122 @@
+#pragma once
+#include<exception>
+#include<utility>
+#include<variant>
+#include "coroutines_ts.h"
+
+namespace cts {
+
+// where a task keeps its outcome: inside the promise, no extra allocation
+template<typename T>
+struct task_result {
+  std::variant<std::monostate, T, std::exception_ptr> m_result;
+  template<typename U>
+  void return_value(U && value) {
+    m_result.template emplace<1>(std::forward<U>(value));
+  }
+  void unhandled_exception() {
+    m_result.template emplace<2>(std::current_exception());
+  }
+  T result() {
+    if (m_result.index() == 2) {
+      std::rethrow_exception(std::get<2>(m_result));
+    }
+    return std::move(std::get<1>(m_result));
+  }
+};
+
+template<>
+struct task_result<void> {
+  std::exception_ptr m_exception;
+  void return_void() {}
+  void unhandled_exception() { m_exception = std::current_exception(); }
+  void result() {
+    if (m_exception) std::rethrow_exception(m_exception);
+  }
+};
+
+/**
+ * Lazily started coroutine that produces a T, or rethrows what it threw,
+ * in the coroutine that co_awaits it. Like MyCoro it can itself await
+ * other tasks, MyFutures and TaskManager::sleepFrames.
+ */
+template<typename T = void>
+struct task {
+  struct promise_type : ContinuationPromise, task_result<T> {
+    promise_type() {
+      Tracer::record(TraceEvent::create, frame());
+    }
+    // a member coroutine gets its object first, which may name the trace
+    template<typename Self, typename... Args>
+    promise_type(Self const& self, Args const&...) : promise_type() {
+      if constexpr (Tracer::enabled && has_trace_name<Self>::value) {
+        Tracer::record(TraceEvent::name, frame(), self.name());
+      }
+    }
+    ~promise_type() {
+      Tracer::record(TraceEvent::destroy, frame());
+    }
+    void const* frame() {
+      return coroutine_handle<promise_type>::from_promise(*this).address();
+    }
+    task get_return_object() {
+      return task{coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    suspend_always initial_suspend() { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+  };
+
+  struct awaiter {
+    coroutine_handle<promise_type> m_coro;
+    bool await_ready() const noexcept { return !m_coro || m_coro.done(); }
+    template<typename Promise>
+    coroutine_handle<> await_suspend(
+        coroutine_handle<Promise> awaiting_coro) noexcept {
+      return m_coro.promise().awaitedBy(awaiting_coro, m_coro);
+    }
+    T await_resume() { return m_coro.promise().result(); }
+  };
+
+  coroutine_handle<promise_type> m_coroutine;
+  explicit task(coroutine_handle<promise_type> coro) : m_coroutine(coro) {}
+  task(task const& by_copy) = delete;
+  task(task && to_move) noexcept : m_coroutine(to_move.m_coroutine) {
+    to_move.m_coroutine = nullptr;
+  }
+  task& operator=(task const& by_copy) = delete;
+  task& operator=(task && to_move) noexcept {
+    if (&to_move != this) {
+      cancel();
+      m_coroutine = to_move.m_coroutine;
+      to_move.m_coroutine = nullptr;
+    }
+    return *this;
+  }
+  ~task() {
+    cancel();
+  }
+
+  awaiter operator co_await() noexcept {
+    return awaiter{m_coroutine};
+  }
+  void start() {
+    m_coroutine.promise().m_started = true;
+    Tracer::record(TraceEvent::resume, m_coroutine.address());
+    m_coroutine.resume();
+  }
+  bool done() const {
+    return m_coroutine && m_coroutine.done();
+  }
+  // for a started task that has finished
+  T result() {
+    return m_coroutine.promise().result();
+  }
+
+  void cancel() {
+    if (m_coroutine) m_coroutine.destroy();
+    m_coroutine = nullptr;
+  }
+};
+
+void run_task_example();
+}
@@ -1,22 +1,77 @@
 #undef _HAS_STD_BYTE
 
-#include "3 MiLi await.hpp"
-// #include "coroutines_ts.h"
-#include "cts_tasks.h"
+#include "benchmark.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
-int __cdecl main() {
-  //int score = 0;
-  cout << "__Coroutine Comparison__\n" << endl;
-  //runMili3();
+namespace {
+void usage() {
+  std::cout << "options: --tasks N --frames N --threads N --json path "
+               "--csv path --trace path --impl name --stagger --examples "
+               "--micro\n";
+}
+}
 
-  //runMili();
-  //runMili2();
+int main(int argc, char** argv) {
+  std::cout << "__Coroutine Comparison__\n" << std::endl;
+  auto config = bench::Config{};
+  auto examples = false;
+  auto micro = false;
+  for (auto i = 1; i < argc; ++i) {
+    auto const arg = argv[i];
+    auto const has_value = i + 1 < argc;
+    if (std::strcmp(arg, "--tasks") == 0 && has_value) {
+      config.m_tasks = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--frames") == 0 && has_value) {
+      config.m_frames = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+      config.m_threads = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--json") == 0 && has_value) {
+      config.m_json_path = argv[++i];
+    } else if (std::strcmp(arg, "--csv") == 0 && has_value) {
+      config.m_csv_path = argv[++i];
+    } else if (std::strcmp(arg, "--trace") == 0 && has_value) {
+      config.m_trace_path = argv[++i];
+    } else if (std::strcmp(arg, "--impl") == 0 && has_value) {
+      config.m_only = argv[++i];
+    } else if (std::strcmp(arg, "--stagger") == 0) {
+      config.m_stagger = true;
+    } else if (std::strcmp(arg, "--examples") == 0) {
+      examples = true;
+    } else if (std::strcmp(arg, "--micro") == 0) {
+      micro = true;
+    } else {
+      usage();
+      return 1;
+    }
+  }
 
-  //cout << "testing simple coroutines with std::future\n";
-  //future_main();
+  if (examples) {
+    bench::run_examples();
+    return 0;
+  }
+  if (micro) {
+    bench::run_micro_benchmarks(config);
+    return 0;
+  }
 
-  cout << "testing Coroutines TS tasks: \n";
-  // cts::run_cts_example();
-  cts::cts_task_benchmark();
+  std::cout << config.m_tasks << " workers, " << config.m_frames
+            << " frames\n";
+  auto const results = bench::run_suite(config);
+  bench::print_results(results);
+  if (!config.m_json_path.empty()
+      && !bench::write_json(config.m_json_path, results)) {
+    std::cout << "could not write " << config.m_json_path << "\n";
+    return 1;
+  }
+  if (!config.m_csv_path.empty()
+      && !bench::write_csv(config.m_csv_path, results)) {
+    std::cout << "could not write " << config.m_csv_path << "\n";
+    return 1;
+  }
+  for (auto const& r : results) {
+    if (r.m_total != r.m_expected) return 2;
+  }
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * MiLi's coroutine macros with the resume point kept as a label address
+ * (the GCC and Clang labels-as-values extension) instead of a line number:
+ * resuming is one indirect jump rather than a switch, which compiles to a
+ * range check and a jump table, or a chain of compares once the cases are
+ * sparse. Other compilers get MiLi's switch, so code written against these
+ * macros builds everywhere.
+ *
+ * Same rules as mili/coroutines.h: no locals alive across a yield, and
+ * the body is bracketed by BEGIN_GOTO_COROUTINE and END_GOTO_COROUTINE.
+ * The state lives in a GotoCoroutine base, so a class can also carry a
+ * mili::Coroutine without the two getting in each other's way.
+ */
+
+// define MILI_COMPUTED_GOTO=0 to compare against the switch
+#ifndef MILI_COMPUTED_GOTO
+#if defined(__GNUC__)
+// Clang defines __GNUC__ too
+#define MILI_COMPUTED_GOTO 1
+#else
+#define MILI_COMPUTED_GOTO 0
+#endif
+#endif
+
+#define MILI_GOTO_LABEL_(line) mili_resume_##line
+#define MILI_GOTO_LABEL(line) MILI_GOTO_LABEL_(line)
+
+#if MILI_COMPUTED_GOTO
+
+class GotoCoroutine
+{
+protected:
+  // where the next resume continues; null starts from the top
+  void* resume_label = nullptr;
+};
+
+#define BEGIN_GOTO_COROUTINE                  \
+  if (resume_label != nullptr)                \
+    goto *resume_label;                       \
+  {
+
+// GCC 12 takes a label address for a local and warns it dangles
+#if defined(__clang__) || __GNUC__ < 12
+#define MILI_STORE_LABEL(label) resume_label = &&label
+#else
+#define MILI_STORE_LABEL(label)                                   \
+  _Pragma("GCC diagnostic push")                                  \
+  _Pragma("GCC diagnostic ignored \"-Wdangling-pointer\"")        \
+  resume_label = &&label;                                         \
+  _Pragma("GCC diagnostic pop")
+#endif
+
+#define goto_yield(value)                         \
+  do                                              \
+  {                                               \
+    MILI_STORE_LABEL(MILI_GOTO_LABEL(__LINE__));  \
+    return (value);                               \
+    MILI_GOTO_LABEL(__LINE__):;                   \
+  }                                               \
+  while(0)
+
+#define END_GOTO_COROUTINE(ret)  \
+  }                              \
+  resume_label = nullptr;        \
+  return (ret)
+
+#else
+
+class GotoCoroutine
+{
+protected:
+  int resume_line = 0;
+};
+
+#define BEGIN_GOTO_COROUTINE  \
+  switch(resume_line)         \
+  {                           \
+    case 0:
+
+#define goto_yield(value)         \
+  do                              \
+  {                               \
+    resume_line = __LINE__;       \
+    return (value);               \
+    case __LINE__:;               \
+  }                               \
+  while(0)
+
+#define END_GOTO_COROUTINE(ret)  \
+  }                              \
+  resume_line = 0;               \
+  return (ret)
+
+#endif
@@ -1,12 +1,27 @@
 #pragma once
+#include "alloc_stats.h"
 #include "scenario.h"
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <functional>
 #include <string>
+#include <vector>
 
 struct Task {
   Worker worker;
   virtual int run() = 0;
+  // trips completed, summed over every worker the task drives
+  virtual int total() const {
+    return worker.total;
+  }
+  // frames from now in which run() would do nothing, so World may skip
+  // them with skipFrames instead
+  virtual int idleFrames() const {
+    return 0;
+  }
+  // only called when idleFrames says so, which by default it never does
+  virtual void skipFrames(int /*frames*/) {}
   virtual void print(ostream& stream) const {
     stream << "overload this" << endl;
   }
@@ -33,29 +48,88 @@ struct TaskManager {
   }
 };
 
+/**
+ * Points a global at value until the end of the scope, then puts back
+ * what it held: for the next_frame2/next_frame3 style sentinels when a
+ * benchmark keeps its own on the stack.
+ */
+template<typename T>
+struct ScopedGlobal {
+  T& m_global;
+  T m_previous;
+  ScopedGlobal(T& global, T value) : m_global(global), m_previous(global) {
+    m_global = value;
+  }
+  ~ScopedGlobal() {
+    m_global = m_previous;
+  }
+  ScopedGlobal(ScopedGlobal const& by_copy) = delete;
+  ScopedGlobal& operator=(ScopedGlobal const& copy) = delete;
+};
+
 struct World {
   int frame = 0;
   Task* task;
+  std::vector<long long> frame_ns;
+  // highest live heap bytes within any one frame of runTimed, kept in
+  // BENCH_ALLOC_STATS builds
+  int64_t max_frame_peak_bytes = 0;
 
   void nextFrame() {
     frame++;
     task->run();
   }
 
+  // fast-forwards over frames the task reports idle
+  void skipIdle(int limit) {
+    auto const idle = std::min(task->idleFrames(), limit - frame);
+    if (idle > 0) {
+      task->skipFrames(idle);
+      frame += idle;
+    }
+  }
+
   int run() {
     auto const start = chrono::high_resolution_clock::now();
-    for (auto i = 0; i < frames_to_run; ++i) 
+    while (frame < frames_to_run)
     {
-      nextFrame();
+      skipIdle(frames_to_run);
+      if (frame < frames_to_run) nextFrame();
     }
     auto const endt = chrono::high_resolution_clock::now();
     auto const diff = endt - start;
     return end(diff);
   }
 
+  // like run, keeping the wall time of every frame run in frame_ns;
+  // between_frames, if set, runs after each frame outside the timing
+  void runTimed(int frames,
+                std::function<void()> const& between_frames = nullptr) {
+    frame_ns.clear();
+    frame_ns.reserve(frames);
+    max_frame_peak_bytes = 0;
+    if (alloc_stats_enabled) resetPeakLiveBytes();
+    while (frame < frames) {
+      auto const start = chrono::steady_clock::now();
+      skipIdle(frames);
+      if (frame < frames) nextFrame();
+      auto const endt = chrono::steady_clock::now();
+      frame_ns.push_back(chrono::nanoseconds(endt - start).count());
+      if (alloc_stats_enabled) {
+        max_frame_peak_bytes =
+          std::max(max_frame_peak_bytes, takePeakLiveBytes());
+      }
+      if (between_frames) between_frames();
+    }
+  }
+
+  int total() const {
+    return task->total();
+  }
+
   int end(chrono::nanoseconds ns) {
     cout << "Completed trips: " << *task << " Time: " << ns.count() << endl;
-    auto const score = task->worker.total;
+    auto const score = total();
     delete task;
     return score;
   }
@@ -0,0 +1,140 @@
+#include "mili_locals.h"
+#include "MiLi/mili/coroutines.h"
+#include "scenario.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace {
+// MiliTask keeping trip statistics across yields in members, declared in
+// the order they come up
+struct MemberTripStats : mili::Coroutine {
+  Worker worker;
+  char phase = 0;
+  double mean_frames = 0;
+  int frames = 0;
+  int64_t trips = 0;
+
+  int run() {
+    BEGIN_COROUTINE
+    while (true) {
+      frames = 0;
+      phase = 'm';
+      while (!worker.atMine()) {
+        worker.moveMine();
+        ++frames;
+        mili_yield(0);
+      }
+      phase = 'g';
+      do {
+        worker.gather();
+        ++frames;
+        mili_yield(0);
+      } while (worker.isMining());
+      phase = 'h';
+      while (!worker.atHome()) {
+        worker.moveHome();
+        ++frames;
+        mili_yield(0);
+      }
+      worker.dropoff();
+      ++frames;
+      ++trips;
+      mean_frames += (frames - mean_frames) / double(trips);
+      mili_yield(0);
+    }
+    END_COROUTINE(0);
+  }
+  double mean() const { return mean_frames; }
+  int64_t count() const { return trips; }
+};
+
+// the same coroutine with the statistics in CoroutineLocals
+struct LocalTripStats : mili::Coroutine {
+  Worker worker;
+  CoroutineLocals<char, double, int, int64_t> m_locals;
+
+  int run() {
+    auto& [phase, mean_frames, frames, trips] = m_locals;
+    BEGIN_COROUTINE
+    while (true) {
+      frames = 0;
+      phase = 'm';
+      while (!worker.atMine()) {
+        worker.moveMine();
+        ++frames;
+        mili_yield(0);
+      }
+      phase = 'g';
+      do {
+        worker.gather();
+        ++frames;
+        mili_yield(0);
+      } while (worker.isMining());
+      phase = 'h';
+      while (!worker.atHome()) {
+        worker.moveHome();
+        ++frames;
+        mili_yield(0);
+      }
+      worker.dropoff();
+      ++frames;
+      ++trips;
+      mean_frames += (frames - mean_frames) / double(trips);
+      mili_yield(0);
+    }
+    END_COROUTINE(0);
+  }
+  double mean() const { return m_locals.get<1>(); }
+  int64_t count() const { return m_locals.get<3>(); }
+};
+
+struct Run {
+  double m_ns_per_yield;
+  double m_mean_frames;
+  int64_t m_trips;
+};
+
+template<typename Coroutine>
+Run runTasks(int tasks, int frames) {
+  std::vector<Coroutine> coroutines(tasks);
+  for (auto i = 0; i < tasks; ++i) {
+    coroutines[i].worker.position = i % distance_to_mine;
+  }
+  auto const start = chrono::steady_clock::now();
+  for (auto f = 0; f < frames; ++f) {
+    for (auto & c : coroutines) {
+      c.run();
+    }
+  }
+  auto const endt = chrono::steady_clock::now();
+  auto run = Run{};
+  run.m_ns_per_yield = chrono::duration<double, std::nano>(endt - start).count()
+                     / (double(tasks) * frames);
+  for (auto const& c : coroutines) {
+    run.m_mean_frames += c.mean() / tasks;
+    run.m_trips += c.count();
+  }
+  return run;
+}
+}
+
+void coroutine_locals_benchmark() {
+  constexpr auto tasks = 100000;
+  constexpr auto frames = 1000;
+  using Locals = decltype(LocalTripStats::m_locals);
+  cout << "coroutine locals: char, double, int, int64_t take "
+       << Locals::frame_size << " bytes, " << sizeof(MemberTripStats)
+       - sizeof(MemberTripStats::worker) - sizeof(mili::Coroutine)
+       << " as members in that order; task " << sizeof(LocalTripStats)
+       << " bytes against " << sizeof(MemberTripStats) << "\n";
+  auto const members = runTasks<MemberTripStats>(tasks, frames);
+  auto const locals = runTasks<LocalTripStats>(tasks, frames);
+  cout << "coroutine locals: " << locals.m_ns_per_yield
+       << " ns per yield, members " << members.m_ns_per_yield << ", "
+       << (locals.m_trips == members.m_trips
+           && locals.m_mean_frames == members.m_mean_frames
+           ? "same trips" : "MISMATCH")
+       << ", " << locals.m_mean_frames << " frames per trip\n";
+}
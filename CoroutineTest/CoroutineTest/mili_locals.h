@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Locals for a MiLi coroutine that live across mili_yield: the Duff's
+ * device jumps past anything declared in the body, so state that has to
+ * survive a yield otherwise ends up in hand-written members or in helper
+ * objects on the heap. Declare the types as one member and bind names to
+ * them at the top of run(), before BEGIN_COROUTINE:
+ *
+ *   CoroutineLocals<char, double, int> m_locals;
+ *   int run() {
+ *     auto& [phase, mean, frames] = m_locals;
+ *     BEGIN_COROUTINE
+ *     ...
+ *
+ * The bindings are re-made on every resume and refer into the storage, so
+ * they keep their values across yields. The storage is laid out by
+ * decreasing alignment, whatever order the types are listed in, so the
+ * only padding is at the end; frame_size is what a task pays for them.
+ * The locals are value-initialised with the coroutine and destroyed with
+ * it, like members.
+ */
+template<typename... Ts>
+class CoroutineLocals {
+  static_assert(sizeof...(Ts) > 0, "no locals to store");
+  static constexpr size_t count = sizeof...(Ts);
+
+  struct Layout {
+    std::array<size_t, count> m_offsets{};
+    size_t m_size = 0;
+  };
+
+  static constexpr Layout layout() {
+    constexpr std::array<size_t, count> aligns{alignof(Ts)...};
+    constexpr std::array<size_t, count> sizes{sizeof(Ts)...};
+    // stable insertion sort, most aligned first
+    std::array<size_t, count> order{};
+    for (size_t i = 0; i < count; ++i) {
+      auto j = i;
+      for (; j > 0 && aligns[order[j - 1]] < aligns[i]; --j) {
+        order[j] = order[j - 1];
+      }
+      order[j] = i;
+    }
+    auto result = Layout{};
+    for (auto const i : order) {
+      result.m_offsets[i] = result.m_size;
+      result.m_size += sizes[i];
+    }
+    return result;
+  }
+
+  static constexpr Layout m_layout = layout();
+  static constexpr size_t max_align = std::max({alignof(Ts)...});
+
+public:
+  static constexpr size_t frame_size =
+    (m_layout.m_size + max_align - 1) / max_align * max_align;
+
+  template<size_t I>
+  using type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+  CoroutineLocals() {
+    construct(std::index_sequence_for<Ts...>{});
+  }
+  CoroutineLocals(CoroutineLocals const& copy) {
+    copyFrom(copy, std::index_sequence_for<Ts...>{});
+  }
+  CoroutineLocals& operator=(CoroutineLocals const& copy) {
+    assignFrom(copy, std::index_sequence_for<Ts...>{});
+    return *this;
+  }
+  ~CoroutineLocals() {
+    destroy(std::index_sequence_for<Ts...>{});
+  }
+
+  template<size_t I>
+  type<I>& get() {
+    return *std::launder(
+      reinterpret_cast<type<I>*>(m_storage + m_layout.m_offsets[I]));
+  }
+  template<size_t I>
+  type<I> const& get() const {
+    return *std::launder(
+      reinterpret_cast<type<I> const*>(m_storage + m_layout.m_offsets[I]));
+  }
+
+private:
+  template<size_t... Is>
+  void construct(std::index_sequence<Is...>) {
+    ((new (m_storage + m_layout.m_offsets[Is]) type<Is>()), ...);
+  }
+  template<size_t... Is>
+  void copyFrom(CoroutineLocals const& copy, std::index_sequence<Is...>) {
+    ((new (m_storage + m_layout.m_offsets[Is])
+        type<Is>(copy.template get<Is>())), ...);
+  }
+  template<size_t... Is>
+  void assignFrom(CoroutineLocals const& copy, std::index_sequence<Is...>) {
+    ((get<Is>() = copy.template get<Is>()), ...);
+  }
+  template<size_t... Is>
+  void destroy(std::index_sequence<Is...>) {
+    (std::destroy_at(&get<Is>()), ...);
+  }
+
+  alignas(Ts...) unsigned char m_storage[frame_size];
+};
+
+// structured bindings over CoroutineLocals
+namespace std {
+template<typename... Ts>
+struct tuple_size<CoroutineLocals<Ts...>>
+  : integral_constant<size_t, sizeof...(Ts)> {};
+
+template<size_t I, typename... Ts>
+struct tuple_element<I, CoroutineLocals<Ts...>> {
+  using type = typename CoroutineLocals<Ts...>::template type<I>;
+};
+}
+
+// frame sizes and per-yield cost of CoroutineLocals against plain members
+void coroutine_locals_benchmark();
@@ -0,0 +1,321 @@
+#include "mili_snapshot.h"
+#include "parallel_world.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+// binary_streams.h needs the rest of mili.h; leave out the parts that do
+// not build as C++20
+#define NO_STRING_UTILS
+#define NO_VARIANTS_SET
+#define NO_STREAM_UTILS
+#define NO_RANKER
+#include "MiLi/mili/mili.h"
+
+namespace {
+constexpr uint32_t snapshot_magic = 0x3353494d; // "MIS3"
+constexpr uint32_t snapshot_version = 2;
+
+// mili3_yield points of a task in phase
+constexpr int resumePoints(int phase) {
+  switch (phase) {
+    case phase_main: return MiliTask3Main::resume_points;
+    case phase_goto_mine: return MiliTask3_GotoMine::resume_points;
+    case phase_gather: return MiliTask3_Gather::resume_points;
+    case phase_dropoff: return MiliTask3_Dropoff::resume_points;
+  }
+  return -1;
+}
+
+// FNV-1a over what a snapshot's meaning depends on: the format, the
+// phases and their resume points, and the Worker bytes
+constexpr uint64_t layoutStamp() {
+  auto hash = uint64_t{14695981039346656037u};
+  auto const mix = [&hash](uint64_t value) {
+    for (auto i = 0; i < 8; ++i) {
+      hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 1099511628211u;
+    }
+  };
+  mix(snapshot_version);
+  mix(sizeof(Worker));
+  mix(num_phases3);
+  for (auto p = 0; p < num_phases3; ++p) {
+    mix(static_cast<uint64_t>(resumePoints(p)));
+  }
+  return hash;
+}
+constexpr uint64_t layout_stamp = layoutStamp();
+
+// magic, version, layout_stamp and the frame, as bostream writes them
+constexpr size_t header_size = 2 * sizeof(uint32_t) + sizeof(uint64_t)
+                             + sizeof(int32_t);
+
+// one subtask in a chain, outermost first
+struct Link {
+  int32_t m_phase;
+  int32_t m_resume_point;
+};
+
+// a queue entry: main task m_task, awaiting m_depth Links
+struct QueueEntry {
+  uint32_t m_task;
+  uint32_t m_depth;
+};
+
+// the bulk path: an array of plain data is one blob laid out like the
+// length-prefixed string bostream would write, appended straight to the
+// snapshot's bytes
+size_t beginPod(std::string& out) {
+  out.append(sizeof(uint32_t), '\0');
+  return out.size();
+}
+
+template<typename T>
+void appendPod(std::string& out, T const& item) {
+  static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+  out.append(reinterpret_cast<char const*>(&item), sizeof(T));
+}
+
+void endPod(std::string& out, size_t start) {
+  auto const length = static_cast<uint32_t>(out.size() - start);
+  std::memcpy(&out[start - sizeof(length)], &length, sizeof(length));
+}
+
+// a blob read in place from the snapshot's bytes
+template<typename T>
+struct PodView {
+  char const* m_data = nullptr;
+  size_t m_size = 0;
+  size_t size() const { return m_size; }
+  T operator[](size_t i) const {
+    T item;
+    std::memcpy(&item, m_data + i * sizeof(T), sizeof(T));
+    return item;
+  }
+};
+
+template<typename T>
+PodView<T> readPod(std::string const& bytes, size_t& pos) {
+  static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+  uint32_t length = 0;
+  if (bytes.size() - pos < sizeof(length)) throw mili::type_mismatch("short snapshot");
+  std::memcpy(&length, bytes.data() + pos, sizeof(length));
+  pos += sizeof(length);
+  if (bytes.size() - pos < length || length % sizeof(T) != 0) {
+    throw mili::type_mismatch("short snapshot");
+  }
+  auto const view = PodView<T>{bytes.data() + pos, length / sizeof(T)};
+  pos += length;
+  return view;
+}
+
+MiliTask3* makeSubtask(int phase, Worker& worker, MiliTask3* caller) {
+  switch (phase) {
+    case phase_goto_mine: return new MiliTask3_GotoMine(worker, caller);
+    case phase_gather: return new MiliTask3_Gather(worker, caller);
+    case phase_dropoff: return new MiliTask3_Dropoff(worker, caller);
+  }
+  throw mili::type_mismatch("no subtask for phase " + std::to_string(phase));
+}
+
+bool validPoint(int phase, int32_t point) {
+  return point >= 0 && point <= resumePoints(phase);
+}
+}
+
+std::string saveSnapshot(World const& world, MiliTask3Mgr const& mgr) {
+  static_assert(std::is_trivially_copyable<Worker>::value, "Worker is saved as bytes");
+  auto const count = mgr.tasks.size();
+  auto const queued = mgr.q.size();
+  mili::bostream<> out;
+  out << snapshot_magic << snapshot_version << layout_stamp
+      << static_cast<int32_t>(world.frame);
+  auto bytes = out.str();
+  bytes.reserve(header_size + 4 * sizeof(uint32_t)
+                + count * (sizeof(Worker) + sizeof(int32_t))
+                + queued * (sizeof(QueueEntry) + sizeof(Link)));
+
+  auto start = beginPod(bytes);
+  for (auto t : mgr.tasks) {
+    appendPod(bytes, t->m_worker);
+  }
+  endPod(bytes, start);
+  start = beginPod(bytes);
+  for (auto t : mgr.tasks) {
+    appendPod(bytes, static_cast<int32_t>(t->resumePoint()));
+  }
+  endPod(bytes, start);
+
+  start = beginPod(bytes);
+  for (size_t i = 0; i < queued; ++i) {
+    auto depth = 0u;
+    auto t = mgr.q[i];
+    for (; t->caller != nullptr; t = t->caller) {
+      ++depth;
+    }
+    auto const main = static_cast<MiliTask3Main const*>(t);
+    appendPod(bytes, QueueEntry{static_cast<uint32_t>(main->index), depth});
+  }
+  endPod(bytes, start);
+  std::vector<MiliTask3 const*> chain;
+  start = beginPod(bytes);
+  for (size_t i = 0; i < queued; ++i) {
+    chain.clear();
+    for (auto t = mgr.q[i]; t->caller != nullptr; t = t->caller) {
+      chain.push_back(t);
+    }
+    for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+      appendPod(bytes, Link{(*link)->phase, (*link)->resumePoint()});
+    }
+  }
+  endPod(bytes, start);
+  return bytes;
+}
+
+void restoreSnapshot(std::string const& bytes, World& world, MiliTask3Mgr& mgr) {
+  if (bytes.size() < header_size) throw mili::type_mismatch("short snapshot");
+  mili::bistream<> in(bytes.substr(0, header_size));
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint64_t stamp = 0;
+  int32_t frame = 0;
+  in >> magic >> version >> stamp >> frame;
+  if (magic != snapshot_magic || version != snapshot_version) {
+    throw mili::type_mismatch("not a MiliTask3Mgr snapshot");
+  }
+  if (stamp != layout_stamp) {
+    throw mili::type_mismatch("snapshot of differently shaped coroutines");
+  }
+  auto pos = header_size;
+  auto const workers = readPod<Worker>(bytes, pos);
+  auto const resume_points = readPod<int32_t>(bytes, pos);
+  auto const entries = readPod<QueueEntry>(bytes, pos);
+  auto const links = readPod<Link>(bytes, pos);
+  if (pos != bytes.size()) throw mili::type_mismatch("trailing bytes");
+
+  // check everything before touching mgr, so a bad snapshot leaves it as is
+  auto const count = workers.size();
+  if (resume_points.size() != count) throw mili::type_mismatch("resume points");
+  for (size_t i = 0; i < count; ++i) {
+    if (!validPoint(phase_main, resume_points[i])) {
+      throw mili::type_mismatch("no such resume point");
+    }
+  }
+  // every main task is queued once, itself or through its chain
+  if (entries.size() != count) throw mili::type_mismatch("queue entries");
+  std::vector<bool> queued(count);
+  size_t link_count = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    auto const e = entries[i];
+    if (e.m_task >= count || queued[e.m_task]) {
+      throw mili::type_mismatch("task queued twice or missing");
+    }
+    queued[e.m_task] = true;
+    link_count += e.m_depth;
+  }
+  if (link_count != links.size()) throw mili::type_mismatch("subtask chains");
+  for (size_t i = 0; i < links.size(); ++i) {
+    auto const link = links[i];
+    if (link.m_phase <= phase_main || link.m_phase >= num_phases3
+        || !validPoint(link.m_phase, link.m_resume_point)) {
+      throw mili::type_mismatch("no such subtask");
+    }
+  }
+
+  mgr.clear();
+  mgr.tasks.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto const t = new MiliTask3Main();
+    t->index = static_cast<int>(i);
+    t->m_worker = workers[i];
+    t->setResumePoint(resume_points[i]);
+    traceCreate(t);
+    mgr.tasks.push_back(t);
+  }
+  mgr.q.reserve(count);
+  size_t next_link = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    auto const e = entries[i];
+    auto const main = mgr.tasks[e.m_task];
+    MiliTask3* t = main;
+    for (auto d = 0u; d < e.m_depth; ++d, ++next_link) {
+      auto const link = links[next_link];
+      t = makeSubtask(link.m_phase, main->worker, t);
+      t->setResumePoint(link.m_resume_point);
+      traceCreate(t);
+    }
+    mgr.q.push(t);
+  }
+  world.frame = frame;
+}
+
+// saves a million workers mid-run, then checks a restored copy finishes
+// the run exactly like the original
+void snapshot_benchmark() {
+  constexpr auto tasks = 1000000;
+  constexpr auto frames = 100;
+  MiliTask3 next_frame;
+  MiliTask3 end_coro;
+  ScopedGlobal<MiliTask3*> use_next_frame(next_frame3, &next_frame);
+  ScopedGlobal<MiliTask3*> use_end_coro(end_coro3, &end_coro);
+  MiliTask3Mgr original;
+  for (auto i = 0; i < tasks; ++i) {
+    original.addTask();
+    // staggered, so the queue holds every kind of chain
+    original.tasks.back()->m_worker.position = i % distance_to_mine;
+  }
+  ManagerShard original_frame(original);
+  World original_world(&original_frame);
+  original_world.runTimed(frames / 2);
+
+  auto const start = chrono::steady_clock::now();
+  auto const bytes = saveSnapshot(original_world, original);
+  auto const saved = chrono::steady_clock::now();
+  MiliTask3Mgr restored;
+  ManagerShard restored_frame(restored);
+  World restored_world(&restored_frame);
+  restoreSnapshot(bytes, restored_world, restored);
+  auto const endt = chrono::steady_clock::now();
+
+  original_world.runTimed(frames);
+  restored_world.runTimed(frames);
+  auto identical = restored_world.frame == original_world.frame
+                && restored.tasks.size() == original.tasks.size()
+                && restored.q.size() == original.q.size();
+  for (size_t i = 0; i < original.tasks.size() && identical; ++i) {
+    auto const& a = original.tasks[i]->m_worker;
+    auto const& b = restored.tasks[i]->m_worker;
+    identical = a.total == b.total && a.carrying == b.carrying
+             && a.position == b.position
+             && a.mining_progress == b.mining_progress;
+  }
+  // a task queued twice, and a yield point run() does not have, must be
+  // turned away without touching the live manager
+  auto const points_at = header_size + 2 * sizeof(uint32_t)
+                       + tasks * sizeof(Worker);
+  auto const entries_at = points_at + tasks * sizeof(int32_t)
+                        + sizeof(uint32_t);
+  auto twice = bytes;
+  std::memcpy(&twice[entries_at + sizeof(QueueEntry)], &twice[entries_at],
+              sizeof(uint32_t));
+  auto bad_point = bytes;
+  bad_point[points_at] = 99;
+  auto rejected = 0;
+  auto const total = restored.total();
+  for (auto const& corrupt : {twice, bad_point}) {
+    try {
+      restoreSnapshot(corrupt, restored_world, restored);
+    } catch (mili::type_mismatch const&) {
+      ++rejected;
+    }
+  }
+  identical = identical && rejected == 2 && restored.total() == total
+           && restored.tasks.size() == original.tasks.size();
+  auto const ms = [](chrono::steady_clock::duration d) {
+    return chrono::duration<double, std::milli>(d).count();
+  };
+  cout << "Snapshot of " << tasks << " MiliTask3 workers: " << bytes.size()
+       << " bytes, save " << ms(saved - start) << " ms, restore "
+       << ms(endt - saved) << " ms" << (identical ? "" : " MISMATCH") << "\n";
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include "3 MiLi await.hpp"
+
+/**
+ * Binary snapshot of a World running a MiliTask3Mgr: the frame, every
+ * Worker, where each main task resumes, the subtask chain it is awaiting
+ * and the order of the queue. Restoring into any MiliTask3Mgr, empty or
+ * not, continues exactly as the saved one would have.
+ *
+ * Yield points are the mili3_yield numbers of "3 MiLi await.hpp", and
+ * the header carries a hash of that layout and of Worker's size, so a
+ * snapshot restores into any build whose coroutines have the same shape.
+ * The per-task arrays are plain data, appended to the bostream bytes as
+ * one blob each and read back in place.
+ */
+std::string saveSnapshot(World const& world, MiliTask3Mgr const& mgr);
+// throws mili::type_mismatch on a short, corrupt or foreign snapshot,
+// leaving world and mgr untouched
+void restoreSnapshot(std::string const& bytes, World& world, MiliTask3Mgr& mgr);
+
+void snapshot_benchmark();
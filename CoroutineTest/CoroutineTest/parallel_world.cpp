@@ -0,0 +1,147 @@
+#include "parallel_world.h"
+#include "3 MiLi await.hpp"
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+void SpinBarrier::arriveAndWait() {
+  auto const generation = m_generation.load(std::memory_order_acquire);
+  if (m_waiting.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // last to arrive opens the next generation
+    m_waiting.store(m_count, std::memory_order_relaxed);
+    m_generation.fetch_add(1, std::memory_order_release);
+    return;
+  }
+  auto spins = 0;
+  while (m_generation.load(std::memory_order_acquire) == generation) {
+    if (++spins > 1000) std::this_thread::yield();
+  }
+}
+
+ParallelWorld::ParallelWorld(std::vector<Task*> p_shards, int p_num_threads)
+: shards(std::move(p_shards)),
+  num_threads(std::max(1, std::min<int>(p_num_threads,
+                                        static_cast<int>(shards.size())))) {}
+
+void ParallelWorld::runTimed(int frames,
+                             std::function<void()> const& between_frames) {
+  frame_ns.clear();
+  frame_ns.reserve(frames);
+  auto const count = static_cast<int>(shards.size());
+  SpinBarrier barrier(num_threads);
+  auto const runShards = [&](int thread) {
+    auto const first = count * thread / num_threads;
+    auto const last = count * (thread + 1) / num_threads;
+    for (auto i = first; i < last; ++i) {
+      shards[i]->run();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (auto t = 1; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (auto f = 0; f < frames; ++f) {
+        runShards(t);
+        barrier.arriveAndWait();
+        if (between_frames) barrier.arriveAndWait();
+      }
+    });
+  }
+  // this thread takes the first range and keeps time
+  max_frame_peak_bytes = 0;
+  if (alloc_stats_enabled) resetPeakLiveBytes();
+  for (auto f = 0; f < frames; ++f) {
+    auto const start = chrono::steady_clock::now();
+    runShards(0);
+    barrier.arriveAndWait();
+    auto const endt = chrono::steady_clock::now();
+    frame_ns.push_back(chrono::nanoseconds(endt - start).count());
+    if (alloc_stats_enabled) {
+      max_frame_peak_bytes =
+        std::max(max_frame_peak_bytes, takePeakLiveBytes());
+    }
+    if (between_frames) {
+      between_frames();
+      barrier.arriveAndWait();
+    }
+    ++frame;
+  }
+  for (auto & t : threads) {
+    t.join();
+  }
+}
+
+int ParallelWorld::total() const {
+  auto count = 0;
+  for (auto shard : shards) {
+    count += shard->total();
+  }
+  return count;
+}
+
+namespace {
+using Mili3Shards = ShardedTasks<MiliTask3Mgr>;
+
+// every worker's state, in task order, to compare runs field by field
+std::vector<Worker> workers(Mili3Shards const& sharded) {
+  std::vector<Worker> result;
+  for (auto const& m : sharded.m_managers) {
+    for (auto t : m->tasks) {
+      result.push_back(t->m_worker);
+    }
+  }
+  return result;
+}
+
+bool sameWorkers(std::vector<Worker> const& a, std::vector<Worker> const& b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+    [](Worker const& x, Worker const& y) {
+      return x.total == y.total && x.carrying == y.carrying
+          && x.position == y.position
+          && x.mining_progress == y.mining_progress;
+    });
+}
+
+Mili3Shards makeShards(int tasks, int count) {
+  return Mili3Shards(tasks, count, [](MiliTask3Mgr& manager, int i) {
+    manager.addTask();
+    // staggered, so shards are not all in the same phase
+    manager.tasks.back()->m_worker.position = i % distance_to_mine;
+  });
+}
+}
+
+void parallel_world_benchmark() {
+  constexpr auto tasks = 100000;
+  constexpr auto frames = 300;
+  constexpr auto num_shards = 64;
+  MiliTask3 next_frame;
+  MiliTask3 end_coro;
+  ScopedGlobal<MiliTask3*> use_next_frame(next_frame3, &next_frame);
+  ScopedGlobal<MiliTask3*> use_end_coro(end_coro3, &end_coro);
+  cout << "ParallelWorld: " << tasks << " MiliTask3 workers in "
+       << num_shards << " shards, " << frames << " frames\n";
+
+  // reference: one manager, one thread
+  auto serial = makeShards(tasks, 1);
+  auto const start = chrono::steady_clock::now();
+  for (auto f = 0; f < frames; ++f) {
+    serial.m_managers.front()->runFrame();
+  }
+  auto const serial_ns =
+    chrono::nanoseconds(chrono::steady_clock::now() - start).count();
+  auto const expected = workers(serial);
+  cout << "serial: " << serial_ns / frames << " ns per frame\n";
+
+  auto const hardware = static_cast<int>(std::thread::hardware_concurrency());
+  for (auto threads = 1; threads <= std::max(16, hardware); threads *= 2) {
+    auto sharded = makeShards(tasks, num_shards);
+    ParallelWorld world(sharded.shards(), threads);
+    world.runTimed(frames);
+    long long total_ns = 0;
+    for (auto const ns : world.frame_ns) total_ns += ns;
+    cout << threads << " threads: " << total_ns / frames << " ns per frame, "
+         << "speedup " << double(serial_ns) / total_ns
+         << (sameWorkers(workers(sharded), expected) ? "" : " MISMATCH")
+         << "\n";
+  }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "mili_helpers.h"
+
+/**
+ * Frame barrier for threads that each have a share of a frame's work.
+ * Waiters spin briefly, since frames are short, then yield so
+ * oversubscribed machines still make progress.
+ */
+struct SpinBarrier {
+  explicit SpinBarrier(int count) : m_count(count), m_waiting(count) {}
+  void arriveAndWait();
+
+private:
+  int const m_count;
+  std::atomic<int> m_waiting;
+  std::atomic<unsigned> m_generation{0};
+};
+
+/**
+ * World over shards that share nothing, e.g. several MiliTask3Mgrs that
+ * each own some of the workers and their own queue. Every thread owns a
+ * contiguous range of shards and runs them for a frame, then all meet at
+ * one barrier. A shard only touches its own tasks, so the outcome is the
+ * same for any thread count and equal to running the shards in turn.
+ */
+struct ParallelWorld {
+  int frame = 0;
+  // not owned
+  std::vector<Task*> shards;
+  int num_threads;
+  std::vector<long long> frame_ns;
+  // as World's; a frame ends when this thread leaves the barrier
+  int64_t max_frame_peak_bytes = 0;
+
+  ParallelWorld(std::vector<Task*> p_shards, int p_num_threads);
+
+  // frame_ns is the time from frame start until every thread is done;
+  // between_frames, if set, runs on this thread while the others wait
+  void runTimed(int frames,
+                std::function<void()> const& between_frames = nullptr);
+  int total() const;
+};
+
+/**
+ * Task that runs one whole frame of a manager with runFrame() and total(),
+ * e.g. a MiliTask3Mgr: a shard for ParallelWorld, or the task of a World.
+ * The manager is not owned.
+ */
+template<typename Manager>
+struct ManagerShard : Task {
+  Manager& m_manager;
+  explicit ManagerShard(Manager& manager) : m_manager(manager) {}
+  int run() override {
+    m_manager.runFrame();
+    return 0;
+  }
+  int total() const override {
+    return m_manager.total();
+  }
+};
+
+/**
+ * A task set split over num_shards managers in contiguous ranges, each
+ * with its ManagerShard: add_task(manager, i) creates task i in the
+ * manager that owns it. Shards keep the order of the tasks, so running
+ * them in turn is the same as one manager running the whole set.
+ */
+template<typename Manager>
+struct ShardedTasks {
+  std::vector<std::unique_ptr<Manager>> m_managers;
+  std::vector<std::unique_ptr<ManagerShard<Manager>>> m_shards;
+
+  template<typename AddTask>
+  ShardedTasks(int tasks, int num_shards, AddTask && add_task) {
+    for (auto s = 0; s < num_shards; ++s) {
+      m_managers.push_back(std::make_unique<Manager>());
+      auto & manager = *m_managers.back();
+      for (auto i = tasks * s / num_shards; i < tasks * (s + 1) / num_shards;
+           ++i) {
+        add_task(manager, i);
+      }
+      m_shards.push_back(std::make_unique<ManagerShard<Manager>>(manager));
+    }
+  }
+
+  // for ParallelWorld
+  std::vector<Task*> shards() const {
+    std::vector<Task*> result;
+    for (auto const& s : m_shards) {
+      result.push_back(s.get());
+    }
+    return result;
+  }
+};
+
+void parallel_world_benchmark();
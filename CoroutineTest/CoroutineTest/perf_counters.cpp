@@ -0,0 +1,83 @@
+#include "perf_counters.h"
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+namespace {
+int openEvent(uint64_t config, int group) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group < 0 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return static_cast<int>(
+    syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+}
+
+PerfCounters::PerfCounters() {
+  uint64_t const events[num_events] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+  };
+  for (auto & fd : m_fds) fd = -1;
+  for (auto i = 0; i < num_events; ++i) {
+    m_fds[i] = openEvent(events[i], i == 0 ? -1 : m_fds[0]);
+    if (m_fds[i] < 0) {
+      // all or nothing, a partial group would mix intervals
+      for (auto & fd : m_fds) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+      }
+      return;
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (auto fd : m_fds) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+void PerfCounters::start() {
+  if (!available()) return;
+  ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::Counts PerfCounters::stop() {
+  auto counts = Counts{};
+  if (!available()) return counts;
+  ioctl(m_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  // PERF_FORMAT_GROUP: the number of events, then one value each
+  uint64_t values[1 + num_events] = {};
+  if (read(m_fds[0], values, sizeof(values)) != sizeof(values)) return counts;
+  counts.m_cycles = static_cast<int64_t>(values[1]);
+  counts.m_instructions = static_cast<int64_t>(values[2]);
+  counts.m_branches = static_cast<int64_t>(values[3]);
+  counts.m_branch_misses = static_cast<int64_t>(values[4]);
+  return counts;
+}
+#else
+PerfCounters::PerfCounters() {
+  for (auto & fd : m_fds) fd = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+
+void PerfCounters::start() {}
+
+PerfCounters::Counts PerfCounters::stop() {
+  return Counts{};
+}
+#endif
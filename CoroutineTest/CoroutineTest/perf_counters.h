@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Hardware counters for the calling thread, read as one group so the
+ * numbers belong to the same interval. Uses perf_event_open on Linux;
+ * elsewhere, or when the kernel refuses (VMs, perf_event_paranoid),
+ * available() is false and every count reads zero.
+ */
+struct PerfCounters {
+  struct Counts {
+    int64_t m_cycles = 0;
+    int64_t m_instructions = 0;
+    int64_t m_branches = 0;
+    int64_t m_branch_misses = 0;
+    double ipc() const {
+      return m_cycles > 0 ? double(m_instructions) / m_cycles : 0;
+    }
+  };
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(PerfCounters const&) = delete;
+  PerfCounters& operator=(PerfCounters const&) = delete;
+
+  bool available() const { return m_fds[0] >= 0; }
+  void start();
+  Counts stop();
+
+private:
+  static constexpr int num_events = 4;
+  // m_fds[0] leads the group
+  int m_fds[num_events];
+};
@@ -0,0 +1,58 @@
+#include "ring_queue.h"
+#include "2 MiLi queue.h"
+#include "benchmark.h"
+#include <chrono>
+#include <deque>
+#include <queue>
+
+namespace {
+// every task in one queue, as in the Nim port: a frame pops, runs and
+// pushes back each task once
+template<typename Queue>
+double nsPerSwitch(int tasks, int frames, int64_t& allocations) {
+  std::vector<Worker> workers(tasks);
+  std::vector<MiliTask2Main> mains;
+  mains.reserve(tasks);
+  Queue q;
+  for (auto & w : workers) {
+    mains.emplace_back(w);
+    q.push(&mains.back());
+  }
+  auto const before = bench::globalAllocations();
+  auto const start = chrono::steady_clock::now();
+  for (auto f = 0; f < frames; ++f) {
+    for (auto n = q.size(); n > 0; --n) {
+      auto const curr = q.front();
+      q.pop();
+      curr->run();
+      q.push(curr);
+    }
+  }
+  auto const endt = chrono::steady_clock::now();
+  allocations = bench::globalAllocations() - before;
+  return chrono::duration<double, std::nano>(endt - start).count()
+       / (double(tasks) * frames);
+}
+}
+
+void ring_queue_benchmark() {
+  MiliTask2 next_frame;
+  MiliTask2 end_coro;
+  ScopedGlobal<MiliTask2*> use_next_frame(next_frame2, &next_frame);
+  ScopedGlobal<MiliTask2*> use_end_coro(end_coro2, &end_coro);
+  cout << "run queue: ns per switch (allocations)\n";
+  for (auto tasks : {1000, 10000, 100000}) {
+    auto const frames = 10000000 / tasks;
+    int64_t deque_allocs = 0;
+    int64_t ring_allocs = 0;
+    auto const deque = nsPerSwitch<queue<MiliTask2*>>(tasks, frames, deque_allocs);
+    auto const ring = nsPerSwitch<RingQueue<MiliTask2*>>(tasks, frames, ring_allocs);
+    cout << tasks << " tasks: std::queue " << deque << " (" << deque_allocs
+         << "), RingQueue " << ring << " (" << ring_allocs << ")\n";
+  }
+  // nim-coroutines/readme.md, 1000 tasks for 1000000 steps
+  cout << "Nim port for reference, 1000 tasks: circular queues "
+       << 7084399600 / 1e9 << " ns per switch, seq futures "
+       << 6122277400 / 1e9 << ", inner circular arrays "
+       << 7010390200 / 1e9 << "\n";
+}
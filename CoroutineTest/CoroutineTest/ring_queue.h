@@ -0,0 +1,76 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// what RingQueue::push does when the ring is full
+enum class RingGrowth {
+  // double the capacity, moving the elements to the new ring
+  grow,
+  // throw std::length_error; the capacity is sized up front
+  fixed
+};
+
+/**
+ * FIFO run queue over a power-of-two ring, so wrapping is a mask and a
+ * task cycling through pop/push every frame never touches the heap. The
+ * std::queue subset the managers use: push, pop, front, size, empty.
+ * Storage is only allocated by reserve() and by growing.
+ */
+template<typename T, RingGrowth Growth = RingGrowth::grow>
+struct RingQueue {
+  RingQueue() = default;
+  // room for at least capacity elements, rounded up to a power of two
+  explicit RingQueue(size_t capacity) { reserve(capacity); }
+
+  bool empty() const { return m_size == 0; }
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_slots.size(); }
+
+  T& front() { return m_slots[m_head]; }
+  T const& front() const { return m_slots[m_head]; }
+  // i places behind the front
+  T const& operator[](size_t i) const { return m_slots[(m_head + i) & m_mask]; }
+
+  void push(T value) {
+    if (m_size == m_slots.size()) {
+      if constexpr (Growth == RingGrowth::fixed) {
+        throw std::length_error("RingQueue full");
+      } else {
+        reserve(m_size == 0 ? min_capacity : m_size * 2);
+      }
+    }
+    m_slots[(m_head + m_size) & m_mask] = std::move(value);
+    ++m_size;
+  }
+
+  void pop() {
+    m_head = (m_head + 1) & m_mask;
+    --m_size;
+  }
+
+  void reserve(size_t capacity) {
+    capacity = std::bit_ceil(capacity);
+    if (capacity <= m_slots.size()) return;
+    // unwrap into the new ring, head at 0
+    std::vector<T> slots(capacity);
+    for (size_t i = 0; i < m_size; ++i) {
+      slots[i] = std::move(m_slots[(m_head + i) & m_mask]);
+    }
+    m_slots.swap(slots);
+    m_head = 0;
+    m_mask = capacity - 1;
+  }
+
+private:
+  static constexpr size_t min_capacity = 8;
+  std::vector<T> m_slots;
+  size_t m_head = 0;
+  size_t m_size = 0;
+  size_t m_mask = 0;
+};
+
+// std::queue against RingQueue running MiliTask2 workers, at 1k to 100k
+void ring_queue_benchmark();
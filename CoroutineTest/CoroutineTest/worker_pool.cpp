@@ -0,0 +1,244 @@
+#include "worker_pool.h"
+#include "1 MiLi coroutine.h"
+#include <chrono>
+#include <iostream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WORKER_POOL_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WORKER_POOL_SSE2 1
+#endif
+
+namespace {
+// one MiliTask::run, written out as the state machine it compiles to
+void stepWorker(Worker& w, int& phase) {
+  if (phase == WorkerPool::to_mine) {
+    if (!w.atMine()) {
+      w.moveMine();
+      return;
+    }
+    phase = WorkerPool::mining;
+    w.gather();
+    return;
+  }
+  if (phase == WorkerPool::mining && w.isMining()) {
+    w.gather();
+    return;
+  }
+  if (!w.atHome()) {
+    phase = WorkerPool::to_home;
+    w.moveHome();
+    return;
+  }
+  phase = WorkerPool::to_mine;
+  w.dropoff();
+}
+
+/**
+ * The same step on a register of lanes. Each lane does exactly one of
+ * move to mine, gather, move home or dropoff, selected by masks, so the
+ * kernel has no branches. V supplies the instruction set.
+ */
+template<typename V>
+void stepLanes(WorkerPool& pool) {
+  using reg = typename V::reg;
+  auto const zero = V::set1(0);
+  auto const one = V::set1(1);
+  auto const speed = V::set1(worker_speed);
+  auto const capacity = V::set1(worker_capacity);
+  auto const mine = V::set1(distance_to_mine);
+  auto const last_mining_frame = V::set1(mining_frames - 1);
+  auto const phase_mining = V::set1(WorkerPool::mining);
+  auto const phase_home = V::set1(WorkerPool::to_home);
+  auto const size = static_cast<int>(pool.m_phase.size());
+  for (auto i = 0; i < size; i += V::width) {
+    reg position = V::load(&pool.m_position[i]);
+    reg progress = V::load(&pool.m_mining_progress[i]);
+    reg carrying = V::load(&pool.m_carrying[i]);
+    reg total = V::load(&pool.m_total[i]);
+    reg const phase = V::load(&pool.m_phase[i]);
+
+    auto const at_mine = V::eq(position, mine);
+    auto const at_home = V::eq(position, zero);
+    auto const is_mining = V::gt(progress, zero);
+    auto const in_to_mine = V::eq(phase, zero);
+    auto const in_mining = V::eq(phase, phase_mining);
+    auto const in_to_home = V::eq(phase, phase_home);
+
+    auto const move_mine = V::andnot(at_mine, in_to_mine);
+    auto const gather = V::or_(V::and_(in_to_mine, at_mine),
+                               V::and_(in_mining, is_mining));
+    auto const heading_home = V::or_(V::andnot(is_mining, in_mining),
+                                     in_to_home);
+    auto const move_home = V::andnot(at_home, heading_home);
+    auto const dropoff = V::and_(heading_home, at_home);
+
+    position = V::add(position, V::and_(move_mine, speed));
+    position = V::sub(position, V::and_(move_home, speed));
+    progress = V::add(progress, V::and_(gather, one));
+    auto const full = V::and_(gather, V::gt(progress, last_mining_frame));
+    carrying = V::or_(V::and_(full, capacity), V::andnot(full, carrying));
+    progress = V::andnot(full, progress);
+    total = V::add(total, V::and_(dropoff, carrying));
+    carrying = V::andnot(dropoff, carrying);
+    auto const next_phase = V::or_(V::and_(gather, phase_mining),
+                                   V::and_(move_home, phase_home));
+
+    V::store(&pool.m_position[i], position);
+    V::store(&pool.m_mining_progress[i], progress);
+    V::store(&pool.m_carrying[i], carrying);
+    V::store(&pool.m_total[i], total);
+    V::store(&pool.m_phase[i], next_phase);
+  }
+}
+
+#if defined(WORKER_POOL_AVX2)
+struct Avx2 {
+  using reg = __m256i;
+  static constexpr int width = 8;
+  static reg load(int const* p) {
+    return _mm256_load_si256(reinterpret_cast<reg const*>(p));
+  }
+  static void store(int* p, reg v) {
+    _mm256_store_si256(reinterpret_cast<reg*>(p), v);
+  }
+  static reg set1(int v) { return _mm256_set1_epi32(v); }
+  static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  static reg sub(reg a, reg b) { return _mm256_sub_epi32(a, b); }
+  static reg eq(reg a, reg b) { return _mm256_cmpeq_epi32(a, b); }
+  static reg gt(reg a, reg b) { return _mm256_cmpgt_epi32(a, b); }
+  static reg and_(reg a, reg b) { return _mm256_and_si256(a, b); }
+  static reg or_(reg a, reg b) { return _mm256_or_si256(a, b); }
+  // ~a & b
+  static reg andnot(reg a, reg b) { return _mm256_andnot_si256(a, b); }
+};
+#elif defined(WORKER_POOL_SSE2)
+struct Sse2 {
+  using reg = __m128i;
+  static constexpr int width = 4;
+  static reg load(int const* p) {
+    return _mm_load_si128(reinterpret_cast<reg const*>(p));
+  }
+  static void store(int* p, reg v) {
+    _mm_store_si128(reinterpret_cast<reg*>(p), v);
+  }
+  static reg set1(int v) { return _mm_set1_epi32(v); }
+  static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_epi32(a, b); }
+  static reg eq(reg a, reg b) { return _mm_cmpeq_epi32(a, b); }
+  static reg gt(reg a, reg b) { return _mm_cmpgt_epi32(a, b); }
+  static reg and_(reg a, reg b) { return _mm_and_si128(a, b); }
+  static reg or_(reg a, reg b) { return _mm_or_si128(a, b); }
+  // ~a & b
+  static reg andnot(reg a, reg b) { return _mm_andnot_si128(a, b); }
+};
+#endif
+}
+
+WorkerPool::WorkerPool(int count) : m_count(count) {
+  auto const padded = (count + lanes - 1) / lanes * lanes;
+  m_total.assign(padded, 0);
+  m_carrying.assign(padded, 0);
+  m_position.assign(padded, 0);
+  m_mining_progress.assign(padded, 0);
+  m_phase.assign(padded, to_mine);
+}
+
+void WorkerPool::nextFrame() {
+#if defined(WORKER_POOL_AVX2)
+  stepLanes<Avx2>(*this);
+#elif defined(WORKER_POOL_SSE2)
+  stepLanes<Sse2>(*this);
+#else
+  nextFrameScalar();
+#endif
+}
+
+void WorkerPool::nextFrameScalar() {
+  auto const size = static_cast<int>(m_phase.size());
+  for (auto i = 0; i < size; ++i) {
+    auto w = worker(i);
+    stepWorker(w, m_phase[i]);
+    m_total[i] = w.total;
+    m_carrying[i] = w.carrying;
+    m_position[i] = w.position;
+    m_mining_progress[i] = w.mining_progress;
+  }
+}
+
+Worker WorkerPool::worker(int index) const {
+  auto w = Worker{};
+  w.total = m_total[index];
+  w.carrying = m_carrying[index];
+  w.position = m_position[index];
+  w.mining_progress = m_mining_progress[index];
+  return w;
+}
+
+int64_t WorkerPool::total() const {
+  int64_t count = 0;
+  for (auto i = 0; i < m_count; ++i) {
+    count += m_total[i];
+  }
+  return count;
+}
+
+char const* worker_pool_kernel() {
+#if defined(WORKER_POOL_AVX2)
+  return "avx2";
+#elif defined(WORKER_POOL_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+namespace {
+bool sameWorker(Worker const& a, Worker const& b) {
+  return a.total == b.total && a.carrying == b.carrying
+      && a.position == b.position && a.mining_progress == b.mining_progress;
+}
+
+template<typename Step>
+int64_t nsPerFrame(int frames, Step && step) {
+  auto const start = std::chrono::high_resolution_clock::now();
+  for (auto f = 0; f < frames; ++f) {
+    step();
+  }
+  auto const endt = std::chrono::high_resolution_clock::now();
+  return std::chrono::nanoseconds(endt - start).count() / frames;
+}
+}
+
+// runs MiliTasks next to both kernels and checks every field every frame
+void worker_pool_benchmark() {
+  cout << "WorkerPool " << worker_pool_kernel() << " kernel vs MiLi\n";
+  constexpr auto frames = 1000;
+  for (auto const count : {1000, 100000, 1000000}) {
+    std::vector<MiliTask> tasks(count);
+    WorkerPool scalar(count);
+    WorkerPool simd(count);
+    auto identical = true;
+    for (auto f = 0; f < 100 && identical; ++f) {
+      for (auto & t : tasks) t.run();
+      scalar.nextFrameScalar();
+      simd.nextFrame();
+      for (auto i = 0; i < count && identical; ++i) {
+        identical = sameWorker(tasks[i].worker, scalar.worker(i))
+                 && sameWorker(tasks[i].worker, simd.worker(i));
+      }
+    }
+    auto const mili_ns = nsPerFrame(frames, [&] {
+      for (auto & t : tasks) t.run();
+    });
+    auto const scalar_ns = nsPerFrame(frames, [&] { scalar.nextFrameScalar(); });
+    auto const simd_ns = nsPerFrame(frames, [&] { simd.nextFrame(); });
+    for (auto i = 0; i < count && identical; ++i) {
+      identical = sameWorker(tasks[i].worker, simd.worker(i));
+    }
+    cout << count << " workers, ns per frame: mili " << mili_ns
+         << ", scalar " << scalar_ns << ", " << worker_pool_kernel() << " "
+         << simd_ns << (identical ? "" : " MISMATCH") << "\n";
+  }
+}
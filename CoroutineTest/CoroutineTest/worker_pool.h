@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "scenario.h"
+
+// vector storage that starts on an align-byte boundary
+template<typename T, size_t align>
+struct AlignedAllocator {
+  using value_type = T;
+  template<typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, align>;
+  };
+  AlignedAllocator() = default;
+  template<typename U>
+  AlignedAllocator(AlignedAllocator<U, align> const&) {}
+  T* allocate(size_t n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{align}));
+  }
+  void deallocate(T* block, size_t) {
+    ::operator delete(block, std::align_val_t{align});
+  }
+  template<typename U>
+  bool operator==(AlignedAllocator<U, align> const&) const { return true; }
+  template<typename U>
+  bool operator!=(AlignedAllocator<U, align> const&) const { return false; }
+};
+
+/**
+ * Workers stored field by field, each field in its own aligned array, so a
+ * frame is a few passes of vector arithmetic instead of one coroutine per
+ * Worker. m_phase records where the MiliTask loop would resume, and a frame
+ * leaves every field exactly as MiliTask::run would.
+ */
+struct WorkerPool {
+  // where the MiliTask state machine is parked
+  enum Phase : int {
+    to_mine = 0,  // while (!atMine()) moveMine
+    mining = 1,   // do gather while (isMining())
+    to_home = 2,  // while (!atHome()) moveHome, then dropoff
+  };
+  // 8 ints fill an AVX2 register; the padding lanes are never reported
+  static constexpr int lanes = 8;
+  using Array = std::vector<int, AlignedAllocator<int, 32>>;
+
+  int m_count = 0;
+  Array m_total;
+  Array m_carrying;
+  Array m_position;
+  Array m_mining_progress;
+  Array m_phase;
+
+  explicit WorkerPool(int count);
+
+  // one MiliTask step for every worker, with the widest kernel built in
+  void nextFrame();
+  // the same step one worker at a time, the reference for nextFrame
+  void nextFrameScalar();
+
+  Worker worker(int index) const;
+  int64_t total() const;
+};
+
+// frame kernel compiled in: "avx2", "sse2" or "scalar"
+char const* worker_pool_kernel();
+void worker_pool_benchmark();